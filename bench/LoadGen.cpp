@@ -0,0 +1,562 @@
+// 基于epoll的HTTP/1.1压测客户端。
+// 每个线程一个epoll，负责一部分连接；每条连接同一时刻只有一个请求在途，收完响应再发下一个。
+// 支持keep-alive和短连接、GET/POST，另可先建立一批只连不发的空闲连接。
+// 测量窗口内每个请求的延迟都保存下来，结束时排序求精确分位数，结果以一行JSON输出到stdout。
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace
+{
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 1316;
+        int conns = 64;
+        int threads = 0; // 0: min(连接数, CPU核数)
+        double duration = 10;
+        double warmup = 1;
+        std::string method = "GET";
+        std::string path = "/index.html";
+        std::string body;
+        std::vector<std::string> headers; // 额外的请求头，如"Accept-Encoding: gzip"
+        bool keepAlive = true;
+        int idle = 0;
+        std::string name = "custom";
+        int serverPid = 0;
+    };
+
+    uint64_t NowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    // 读/proc/<pid>/status里的VmRSS，单位KB，失败返回-1
+    long ServerRssKb(int pid)
+    {
+        if (pid <= 0)
+        {
+            return -1;
+        }
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/status", pid);
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+        {
+            return -1;
+        }
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (strncmp(line, "VmRSS:", 6) == 0)
+            {
+                kb = strtol(line + 6, nullptr, 10);
+                break;
+            }
+        }
+        fclose(fp);
+        return kb;
+    }
+
+    struct Stats
+    {
+        std::vector<uint64_t> latency; // 纳秒，只记测量窗口内完成的请求
+        uint64_t requests = 0;
+        uint64_t bytes = 0;  // 测量窗口内完成的响应字节数
+        uint64_t errors = 0;
+        uint64_t connects = 0;
+        uint64_t status[6] = {0}; // 按百位分类，下标0为无法解析的状态行
+    };
+
+    struct Conn
+    {
+        int fd = -1;
+        bool connecting = false;
+        size_t sent = 0;
+        uint64_t start = 0;
+        std::string head; // 响应头，找到空行前累积
+        bool headerDone = false;
+        size_t headerLen = 0;
+        size_t contentLen = 0;
+        size_t bodyRead = 0;
+        int status = 0;
+        bool serverClose = false;
+    };
+
+    class Worker
+    {
+    public:
+        Worker(const Options &opt, const sockaddr_in &addr, const std::string &request, int conns,
+               uint64_t measureBegin, uint64_t measureEnd)
+            : _opt(opt), _addr(addr), _request(request), _conns(conns),
+              _measureBegin(measureBegin), _measureEnd(measureEnd) {}
+
+        void Run();
+        Stats &GetStats() { return _stats; }
+
+    private:
+        static const int READ_BUF = 64 * 1024;
+
+        void Open_(Conn &c);
+        void Close_(Conn &c);
+        void Fail_(Conn &c);
+        void Send_(Conn &c);
+        void Recv_(Conn &c);
+        void Complete_(Conn &c);
+        bool ParseHeader_(Conn &c);
+
+        const Options &_opt;
+        sockaddr_in _addr;
+        const std::string &_request;
+        int _conns;
+        uint64_t _measureBegin, _measureEnd;
+        int _epfd = -1;
+        std::vector<Conn> _pool;
+        Stats _stats;
+        char _buf[READ_BUF];
+    };
+
+    void Worker::Run()
+    {
+        _epfd = epoll_create1(EPOLL_CLOEXEC);
+        _pool.resize(_conns);
+        _stats.latency.reserve(1 << 16);
+        for (auto &c : _pool)
+        {
+            Open_(c);
+        }
+        struct epoll_event events[256];
+        while (NowNs() < _measureEnd)
+        {
+            int n = epoll_wait(_epfd, events, 256, 100);
+            for (int i = 0; i < n; ++i)
+            {
+                Conn &c = _pool[events[i].data.u32];
+                if (c.fd < 0)
+                {
+                    continue;
+                }
+                if (c.connecting)
+                {
+                    int err = 0;
+                    socklen_t len = sizeof(err);
+                    getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                    if (err != 0)
+                    {
+                        Fail_(c);
+                        continue;
+                    }
+                    c.connecting = false;
+                    Send_(c);
+                }
+                else if (events[i].events & EPOLLOUT)
+                {
+                    Send_(c);
+                }
+                else
+                {
+                    Recv_(c);
+                }
+            }
+        }
+        for (auto &c : _pool)
+        {
+            Close_(c);
+        }
+        close(_epfd);
+    }
+
+    // 新建连接，建连时间计入第一个请求的延迟
+    void Worker::Open_(Conn &c)
+    {
+        c.start = NowNs();
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.fd < 0)
+        {
+            _stats.errors++;
+            return;
+        }
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        _stats.connects++;
+        c.connecting = true;
+        c.sent = 0;
+        struct epoll_event ev = {0};
+        ev.events = EPOLLOUT;
+        ev.data.u32 = static_cast<uint32_t>(&c - _pool.data());
+        epoll_ctl(_epfd, EPOLL_CTL_ADD, c.fd, &ev);
+        if (connect(c.fd, (const sockaddr *)&_addr, sizeof(_addr)) < 0 && errno != EINPROGRESS)
+        {
+            // 立即失败(如连接被拒)不再重试，这条连接就此作废
+            _stats.errors++;
+            Close_(c);
+        }
+    }
+
+    void Worker::Close_(Conn &c)
+    {
+        if (c.fd >= 0)
+        {
+            close(c.fd);
+            c.fd = -1;
+        }
+    }
+
+    void Worker::Fail_(Conn &c)
+    {
+        _stats.errors++;
+        Close_(c);
+        if (NowNs() < _measureEnd)
+        {
+            Open_(c);
+        }
+    }
+
+    void Worker::Send_(Conn &c)
+    {
+        if (c.sent == 0)
+        {
+            c.head.clear();
+            c.headerDone = false;
+            c.contentLen = c.bodyRead = 0;
+            c.status = 0;
+            c.serverClose = false;
+        }
+        while (c.sent < _request.size())
+        {
+            ssize_t n = send(c.fd, _request.data() + c.sent, _request.size() - c.sent, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+                Fail_(c);
+                return;
+            }
+            c.sent += n;
+        }
+        struct epoll_event ev = {0};
+        ev.events = c.sent < _request.size() ? EPOLLOUT : EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(&c - _pool.data());
+        epoll_ctl(_epfd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    // 解析状态码、Content-Length和Connection: close，头部不完整返回false
+    bool Worker::ParseHeader_(Conn &c)
+    {
+        size_t end = c.head.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        c.headerDone = true;
+        c.headerLen = end + 4;
+        if (c.head.compare(0, 5, "HTTP/") == 0 && c.head.size() > 12)
+        {
+            c.status = atoi(c.head.c_str() + 9);
+        }
+        size_t pos = c.head.find("\r\n");
+        while (pos < end)
+        {
+            size_t next = c.head.find("\r\n", pos + 2);
+            std::string line = c.head.substr(pos + 2, next - pos - 2);
+            if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0)
+            {
+                c.contentLen = strtoul(line.c_str() + 15, nullptr, 10);
+            }
+            else if (strncasecmp(line.c_str(), "Connection:", 11) == 0 && strcasestr(line.c_str() + 11, "close"))
+            {
+                c.serverClose = true;
+            }
+            pos = next;
+        }
+        c.bodyRead = c.head.size() - c.headerLen;
+        return true;
+    }
+
+    void Worker::Recv_(Conn &c)
+    {
+        while (true)
+        {
+            ssize_t n = recv(c.fd, _buf, READ_BUF, 0);
+            if (n < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    return;
+                }
+                Fail_(c);
+                return;
+            }
+            if (n == 0)
+            {
+                Fail_(c); // 响应收完前被对端关闭
+                return;
+            }
+            if (!c.headerDone)
+            {
+                c.head.append(_buf, n);
+                if (!ParseHeader_(c))
+                {
+                    if (c.head.size() > 64 * 1024)
+                    {
+                        Fail_(c);
+                        return;
+                    }
+                    continue;
+                }
+            }
+            else
+            {
+                c.bodyRead += n;
+            }
+            if (c.bodyRead >= c.contentLen)
+            {
+                Complete_(c);
+                return;
+            }
+        }
+    }
+
+    void Worker::Complete_(Conn &c)
+    {
+        uint64_t now = NowNs();
+        if (now >= _measureBegin && now < _measureEnd)
+        {
+            _stats.latency.push_back(now - c.start);
+            _stats.requests++;
+            _stats.bytes += c.headerLen + c.contentLen;
+            _stats.status[c.status >= 100 && c.status < 600 ? c.status / 100 : 0]++;
+        }
+        if (now >= _measureEnd)
+        {
+            return;
+        }
+        if (!_opt.keepAlive || c.serverClose)
+        {
+            Close_(c);
+            Open_(c);
+            return;
+        }
+        c.start = now;
+        c.sent = 0;
+        Send_(c);
+    }
+
+    std::string BuildRequest(const Options &opt)
+    {
+        std::string req = opt.method + " " + opt.path + " HTTP/1.1\r\n";
+        req += "Host: " + opt.host + ":" + std::to_string(opt.port) + "\r\n";
+        req += opt.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        for (const std::string &header : opt.headers)
+        {
+            req += header + "\r\n";
+        }
+        if (!opt.body.empty() || opt.method == "POST")
+        {
+            req += "Content-Type: application/x-www-form-urlencoded\r\n";
+            req += "Content-Length: " + std::to_string(opt.body.size()) + "\r\n";
+        }
+        req += "\r\n";
+        req += opt.body;
+        return req;
+    }
+
+    // 阻塞地建立空闲连接，成功的个数
+    int OpenIdle(const sockaddr_in &addr, int count, std::vector<int> &fds)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                break;
+            }
+            if (connect(fd, (const sockaddr *)&addr, sizeof(addr)) < 0)
+            {
+                close(fd);
+                break;
+            }
+            fds.push_back(fd);
+        }
+        return static_cast<int>(fds.size());
+    }
+
+    double Percentile(const std::vector<uint64_t> &sorted, double q)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        size_t idx = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(idx, sorted.size() - 1)] / 1000.0;
+    }
+
+    void Usage(const char *prog)
+    {
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -H host        server address (127.0.0.1)\n"
+                "  -p port        server port (1316)\n"
+                "  -c conns       concurrent connections (64)\n"
+                "  -t threads     client threads (min(conns, cpus))\n"
+                "  -d seconds     measured duration (10)\n"
+                "  -w seconds     warmup before measuring (1)\n"
+                "  -m method      GET or POST (GET)\n"
+                "  -u path        request path (/index.html)\n"
+                "  -b body        request body, implies a form Content-Type\n"
+                "  -A header      extra request header line, repeatable\n"
+                "  -C             one request per connection (Connection: close)\n"
+                "  -i idle        extra idle connections held open during the run (0)\n"
+                "  -n name        scenario name in the JSON output\n"
+                "  -P pid         server pid, its VmRSS is reported\n",
+                prog);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int ch;
+    while ((ch = getopt(argc, argv, "H:p:c:t:d:w:m:u:b:A:Ci:n:P:h")) != -1)
+    {
+        switch (ch)
+        {
+        case 'H': opt.host = optarg; break;
+        case 'p': opt.port = atoi(optarg); break;
+        case 'c': opt.conns = std::max(1, atoi(optarg)); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'd': opt.duration = atof(optarg); break;
+        case 'w': opt.warmup = atof(optarg); break;
+        case 'm': opt.method = optarg; break;
+        case 'u': opt.path = optarg; break;
+        case 'b': opt.body = optarg; break;
+        case 'A': opt.headers.push_back(optarg); break;
+        case 'C': opt.keepAlive = false; break;
+        case 'i': opt.idle = atoi(optarg); break;
+        case 'n': opt.name = optarg; break;
+        case 'P': opt.serverPid = atoi(optarg); break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // 空闲连接和压测连接都要占fd
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1)
+    {
+        struct hostent *he = gethostbyname(opt.host.c_str());
+        if (!he)
+        {
+            fprintf(stderr, "unknown host %s\n", opt.host.c_str());
+            return 1;
+        }
+        memcpy(&addr.sin_addr, he->h_addr_list[0], sizeof(addr.sin_addr));
+    }
+
+    long rssBefore = ServerRssKb(opt.serverPid);
+    std::vector<int> idleFds;
+    int idleOpened = OpenIdle(addr, opt.idle, idleFds);
+    long rssIdle = ServerRssKb(opt.serverPid);
+
+    int threads = opt.threads > 0 ? opt.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threads = std::min(threads, opt.conns);
+    std::string request = BuildRequest(opt);
+    uint64_t begin = NowNs() + static_cast<uint64_t>(opt.warmup * 1e9);
+    uint64_t end = begin + static_cast<uint64_t>(opt.duration * 1e9);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i)
+    {
+        int conns = opt.conns / threads + (i < opt.conns % threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, addr, request, conns, begin, end));
+    }
+    for (auto &w : workers)
+    {
+        pool.emplace_back(&Worker::Run, w.get());
+    }
+    for (auto &t : pool)
+    {
+        t.join();
+    }
+    long rssAfter = ServerRssKb(opt.serverPid);
+    for (int fd : idleFds)
+    {
+        close(fd);
+    }
+
+    Stats total;
+    for (auto &w : workers)
+    {
+        Stats &s = w->GetStats();
+        total.latency.insert(total.latency.end(), s.latency.begin(), s.latency.end());
+        total.requests += s.requests;
+        total.bytes += s.bytes;
+        total.errors += s.errors;
+        total.connects += s.connects;
+        for (int i = 0; i < 6; ++i)
+        {
+            total.status[i] += s.status[i];
+        }
+    }
+    std::sort(total.latency.begin(), total.latency.end());
+    double sum = 0;
+    for (uint64_t v : total.latency)
+    {
+        sum += v;
+    }
+    double mean = total.latency.empty() ? 0 : sum / total.latency.size() / 1000.0;
+
+    printf("{\"scenario\":\"%s\",\"method\":\"%s\",\"path\":\"%s\",\"keepalive\":%s,"
+           "\"connections\":%d,\"threads\":%d,\"idle_connections\":%d,\"duration_s\":%.3f,"
+           "\"requests\":%llu,\"errors\":%llu,\"connects\":%llu,\"rps\":%.1f,\"mb_per_s\":%.2f,"
+           "\"latency_us\":{\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f},"
+           "\"status\":{\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu,\"other\":%llu},"
+           "\"server_rss_kb\":{\"before\":%ld,\"idle\":%ld,\"after\":%ld}}\n",
+           opt.name.c_str(), opt.method.c_str(), opt.path.c_str(), opt.keepAlive ? "true" : "false",
+           opt.conns, threads, idleOpened, opt.duration,
+           (unsigned long long)total.requests, (unsigned long long)total.errors, (unsigned long long)total.connects,
+           total.requests / opt.duration, total.bytes / opt.duration / (1024.0 * 1024.0),
+           mean, Percentile(total.latency, 0.5), Percentile(total.latency, 0.9), Percentile(total.latency, 0.99),
+           Percentile(total.latency, 0.999), total.latency.empty() ? 0.0 : total.latency.back() / 1000.0,
+           (unsigned long long)total.status[2], (unsigned long long)total.status[3],
+           (unsigned long long)total.status[4], (unsigned long long)total.status[5],
+           (unsigned long long)(total.status[0] + total.status[1]),
+           rssBefore, rssIdle, rssAfter);
+    return 0;
+}
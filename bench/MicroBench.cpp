@@ -0,0 +1,506 @@
+// 微基准：Buffer、HttpRequest::parse、TimingWheel和Log的单项开销。
+// 每个用例先把迭代次数翻倍到单轮耗时超过目标的1/4，再按比例放大跑REPEAT轮，取最快一轮的ns/op。
+// 全局operator new被替换成计数版本，allocs/op为测量轮内所有线程的分配次数除以迭代次数。
+// 用法: microbench [-j] [-t ms] [-l] [过滤子串...]，-j每个用例输出一行JSON，-l只列出用例名。
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+
+#include "../src/Buffer/Buffer.hpp"
+#include "../src/Buffer/ChainBuffer.hpp"
+#include "../src/HttpRequest/HttpRequest.hpp"
+#include "../src/TimingWheel/TimingWheel.hpp"
+#include "../src/Log/Log.hpp"
+
+namespace
+{
+    std::atomic<uint64_t> g_allocs(0);
+
+    uint64_t NowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    // 防止被测表达式的结果被优化掉
+    template <typename T>
+    inline void DoNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // 测试数据用的伪随机数，不引入<random>的状态开销
+    struct XorShift
+    {
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        uint32_t operator()()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return static_cast<uint32_t>(state);
+        }
+    };
+
+    // 用例只把被测循环包在Start/Stop之间，准备数据和清理不计入
+    struct State
+    {
+        uint64_t ns = 0;
+        uint64_t allocs = 0;
+        uint64_t begin = 0;
+        uint64_t allocBegin = 0;
+
+        void Start()
+        {
+            allocBegin = g_allocs.load(std::memory_order_relaxed);
+            begin = NowNs();
+        }
+        void Stop()
+        {
+            ns += NowNs() - begin;
+            allocs += g_allocs.load(std::memory_order_relaxed) - allocBegin;
+        }
+    };
+
+    // 一个用例：run(n, st)执行n次操作
+    struct Case
+    {
+        std::string name;
+        std::function<void(uint64_t, State &)> run;
+    };
+
+    struct Result
+    {
+        uint64_t iters;
+        double nsPerOp;
+        double allocsPerOp;
+    };
+
+    const int REPEAT = 3;
+
+    Result Measure(const Case &c, uint64_t targetNs)
+    {
+        uint64_t iters = 1;
+        while (true)
+        {
+            State st;
+            c.run(iters, st);
+            if (st.ns >= targetNs / 4 || iters >= (1ull << 30))
+            {
+                iters = std::max<uint64_t>(1, iters * targetNs / std::max<uint64_t>(st.ns, 1));
+                break;
+            }
+            iters *= 2;
+        }
+        Result best = {iters, 1e300, 0};
+        for (int i = 0; i < REPEAT; ++i)
+        {
+            State st;
+            c.run(iters, st);
+            double ns = static_cast<double>(st.ns) / iters;
+            if (ns < best.nsPerOp)
+            {
+                best.nsPerOp = ns;
+                best.allocsPerOp = static_cast<double>(st.allocs) / iters;
+            }
+        }
+        return best;
+    }
+
+    // ---------------- Buffer ----------------
+
+    void AddBufferCases(std::vector<Case> &cases)
+    {
+        for (size_t size : {16, 256, 4096, 65536})
+        {
+            cases.push_back({"buffer/append_retrieve/" + std::to_string(size), [size](uint64_t n, State &st)
+                             {
+                                 Buffer buff;
+                                 std::string data(size, 'x');
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     buff.Append(data.data(), size);
+                                     buff.Retrieve(size);
+                                 }
+                                 st.Stop();
+                                 DoNotOptimize(buff.ReadableBytes());
+                             }});
+        }
+        // 先攒一批小块再一次取走，覆盖扩容和搬移
+        for (int batch : {8, 64, 512})
+        {
+            cases.push_back({"buffer/append_batch_retrieve_all/" + std::to_string(batch), [batch](uint64_t n, State &st)
+                             {
+                                 Buffer buff;
+                                 const char line[] = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n\r\n";
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     for (int j = 0; j < batch; ++j)
+                                     {
+                                         buff.Append(line, sizeof(line) - 1);
+                                     }
+                                     buff.RetrieveAll();
+                                 }
+                                 st.Stop();
+                                 DoNotOptimize(buff.ReadableBytes());
+                             }});
+        }
+        // 数据先写进管道，ReadFd一次读出
+        for (size_t size : {512, 4096, 32768})
+        {
+            cases.push_back({"buffer/readfd/" + std::to_string(size), [size](uint64_t n, State &st)
+                             {
+                                 int fds[2];
+                                 if (pipe2(fds, O_NONBLOCK) < 0)
+                                 {
+                                     return;
+                                 }
+                                 std::string data(size, 'x');
+                                 Buffer buff;
+                                 int err = 0;
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     if (write(fds[1], data.data(), size) != static_cast<ssize_t>(size))
+                                     {
+                                         break;
+                                     }
+                                     buff.ReadFd(fds[0], &err);
+                                     buff.RetrieveAll();
+                                 }
+                                 st.Stop();
+                                 close(fds[0]);
+                                 close(fds[1]);
+                             }});
+        }
+        for (size_t size : {64, 4096, 65536})
+        {
+            cases.push_back({"chainbuffer/append_retrieve_all/" + std::to_string(size), [size](uint64_t n, State &st)
+                             {
+                                 ChainBuffer buff;
+                                 std::string data(size, 'x');
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     buff.Append(data.data(), size);
+                                     buff.RetrieveAll();
+                                 }
+                                 st.Stop();
+                                 DoNotOptimize(buff.ReadableBytes());
+                             }});
+        }
+    }
+
+    // ---------------- HttpRequest::parse ----------------
+
+    std::string MakeRequest(int headers, const std::string &body = "")
+    {
+        std::string req = body.empty() ? "GET /index.html HTTP/1.1\r\n" : "POST /index.html HTTP/1.1\r\n";
+        req += "Connection: keep-alive\r\n";
+        for (int i = 1; i < headers; ++i)
+        {
+            req += "X-Bench-Header-" + std::to_string(i) + ": value-" + std::to_string(i) + "\r\n";
+        }
+        if (!body.empty())
+        {
+            req += "Content-Type: application/x-www-form-urlencoded\r\n";
+            req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        req += "\r\n";
+        req += body;
+        return req;
+    }
+
+    // 与HttpConn::process一样：解析、丢弃已解析的字节、复位解析器
+    void ParseLoop(const std::string &req, uint64_t n, State &st)
+    {
+        Buffer buff;
+        HttpRequest request;
+        st.Start();
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            buff.Append(req);
+            HttpRequest::HTTP_CODE ret = request.parse(buff);
+            DoNotOptimize(ret);
+            buff.Retrieve(ret == HttpRequest::GET_REQUEST ? request.Consumed() : buff.ReadableBytes());
+            request.Init();
+        }
+        st.Stop();
+    }
+
+    void AddParseCases(std::vector<Case> &cases)
+    {
+        for (int headers : {1, 8, 16, 32})
+        {
+            std::string req = MakeRequest(headers);
+            cases.push_back({"parse/get_headers/" + std::to_string(headers), [req](uint64_t n, State &st)
+                             { ParseLoop(req, n, st); }});
+        }
+        std::string form = "username=bench&password=bench&remember=on&next=%2Fwelcome.html";
+        std::string post = MakeRequest(4, form);
+        cases.push_back({"parse/post_form/4", [post](uint64_t n, State &st)
+                         { ParseLoop(post, n, st); }});
+        // 请求分两次到达，第二次parse要接着上次的进度
+        std::string req = MakeRequest(8);
+        cases.push_back({"parse/split_headers/8", [req](uint64_t n, State &st)
+                         {
+                             Buffer buff;
+                             HttpRequest request;
+                             size_t half = req.size() / 2;
+                             st.Start();
+                             for (uint64_t i = 0; i < n; ++i)
+                             {
+                                 buff.Append(req.data(), half);
+                                 DoNotOptimize(request.parse(buff));
+                                 buff.Append(req.data() + half, req.size() - half);
+                                 DoNotOptimize(request.parse(buff));
+                                 buff.Retrieve(request.Consumed());
+                                 request.Init();
+                             }
+                             st.Stop();
+                         }});
+    }
+
+    // ---------------- TimingWheel ----------------
+
+    // 预先挂上live个超时在1~60秒之间的定时器，op本身不会触发到期
+    void FillTimers(TimingWheel &timer, int live, XorShift &rng)
+    {
+        for (int id = 0; id < live; ++id)
+        {
+            timer.add(id, 1000 + rng() % 59000, [] {});
+        }
+    }
+
+    void AddTimerCases(std::vector<Case> &cases)
+    {
+        for (int live : {1000, 10000, 100000})
+        {
+            std::string n = std::to_string(live);
+            cases.push_back({"timer/adjust/" + n, [live](uint64_t n, State &st)
+                             {
+                                 TimingWheel timer;
+                                 XorShift rng;
+                                 FillTimers(timer, live, rng);
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     timer.adjust(rng() % live, 1000 + rng() % 59000);
+                                 }
+                                 st.Stop();
+                             }});
+            cases.push_back({"timer/add_cancel/" + n, [live](uint64_t n, State &st)
+                             {
+                                 TimingWheel timer;
+                                 XorShift rng;
+                                 FillTimers(timer, live, rng);
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     timer.add(live, 1000 + rng() % 59000, [] {});
+                                     timer.cancel(live);
+                                 }
+                                 st.Stop();
+                             }});
+            // 事件循环每轮调用一次：推进时间轮并找下一个非空槽
+            cases.push_back({"timer/get_next_tick/" + n, [live](uint64_t n, State &st)
+                             {
+                                 TimingWheel timer;
+                                 XorShift rng;
+                                 FillTimers(timer, live, rng);
+                                 st.Start();
+                                 for (uint64_t i = 0; i < n; ++i)
+                                 {
+                                     DoNotOptimize(timer.getNextTick());
+                                 }
+                                 st.Stop();
+                             }});
+        }
+    }
+
+    // ---------------- Log ----------------
+
+    std::string g_logDir;
+
+    // threads个线程共写n行，计时包括最后把缓冲区写进文件
+    void AddLogCases(std::vector<Case> &cases)
+    {
+        for (int threads : {1, 2, 4, 8, 16, 32})
+        {
+            cases.push_back({"log/write_async/" + std::to_string(threads), [threads](uint64_t n, State &st)
+                             {
+                                 std::vector<std::thread> producers;
+                                 st.Start();
+                                 for (int t = 0; t < threads; ++t)
+                                 {
+                                     uint64_t lines = n / threads + (static_cast<uint64_t>(t) < n % threads ? 1 : 0);
+                                     producers.emplace_back([lines]
+                                                            {
+                                                                for (uint64_t i = 0; i < lines; ++i)
+                                                                {
+                                                                    LOG_INFO("Client[%d](%s:%d) in, userCount:%d", 42, "127.0.0.1", 50000, (int)i);
+                                                                }
+                                                            });
+                                 }
+                                 for (auto &t : producers)
+                                 {
+                                     t.join();
+                                 }
+                                 Log::Instance()->Flush();
+                                 st.Stop();
+                             }});
+        }
+        cases.push_back({"log/filtered_level", [](uint64_t n, State &st)
+                         {
+                             st.Start();
+                             for (uint64_t i = 0; i < n; ++i)
+                             {
+                                 LOG_DEBUG("not written: %d", (int)i);
+                             }
+                             st.Stop();
+                         }});
+    }
+
+    void Usage(const char *prog)
+    {
+        fprintf(stderr, "usage: %s [-j] [-t ms] [-l] [filter...]\n"
+                        "  -j      one JSON object per case\n"
+                        "  -t ms   target time per measured round (200)\n"
+                        "  -l      list case names\n",
+                prog);
+    }
+}
+
+// 统计分配次数，其余交给malloc/free
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false, list = false;
+    uint64_t targetMs = 200;
+    int ch;
+    while ((ch = getopt(argc, argv, "jt:lh")) != -1)
+    {
+        switch (ch)
+        {
+        case 'j': json = true; break;
+        case 't': targetMs = std::max(1, atoi(optarg)); break;
+        case 'l': list = true; break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    std::vector<std::string> filters(argv + optind, argv + argc);
+
+    std::vector<Case> cases;
+    AddBufferCases(cases);
+    AddParseCases(cases);
+    AddTimerCases(cases);
+    AddLogCases(cases);
+
+    // 日志写进临时目录，跑完删除
+    char dirTemplate[] = "/tmp/microbench-log-XXXXXX";
+    g_logDir = mkdtemp(dirTemplate) ? dirTemplate : "/tmp";
+    Log::Instance()->Init(1, g_logDir.c_str(), ".log", 1024);
+
+    if (!json && !list)
+    {
+        printf("%-40s %12s %12s %12s\n", "case", "iters", "ns/op", "allocs/op");
+    }
+    for (const Case &c : cases)
+    {
+        bool match = filters.empty();
+        for (const std::string &f : filters)
+        {
+            match = match || c.name.find(f) != std::string::npos;
+        }
+        if (!match)
+        {
+            continue;
+        }
+        if (list)
+        {
+            printf("%s\n", c.name.c_str());
+            continue;
+        }
+        Result r = Measure(c, targetMs * 1000000);
+        if (json)
+        {
+            printf("{\"case\":\"%s\",\"iters\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.4f}\n",
+                   c.name.c_str(), (unsigned long long)r.iters, r.nsPerOp, r.allocsPerOp);
+        }
+        else
+        {
+            printf("%-40s %12llu %12.2f %12.4f\n", c.name.c_str(), (unsigned long long)r.iters, r.nsPerOp, r.allocsPerOp);
+        }
+        fflush(stdout);
+    }
+
+    std::string rm = "rm -rf " + g_logDir;
+    if (g_logDir != "/tmp" && system(rm.c_str()) != 0)
+    {
+        fprintf(stderr, "failed to remove %s\n", g_logDir.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+// 压测用的MySQL客户端桩：用进程内的用户表代替数据库，只实现服务器用到的几个接口，
+// 只认SqlConn预编译的查询和插入语句，以及启动时检查唯一键的查询。链接bench_server时代替-lmysqlclient，
+// 登录场景测到的是服务器自身的开销，而不是数据库的。
+// 预置用户bench/bench，注册的新用户在进程退出前一直有效。
+// 环境变量STUB_SQL_DELAY_US可给每次执行加上固定延迟，模拟数据库往返。
+// 环境变量STUB_SQL_DOWN_FILE指定一个路径，该文件存在期间"数据库"不可达：建连、ping、执行都失败；
+// 文件删除后视为数据库重启过，之前建立的连接全部失效，必须重连。用来演练故障切换。
+#include <mysql/mysql.h>
+#include <mysql/mysqld_error.h>
+#include <mysql/errmsg.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::mutex g_mtx;
+    std::unordered_map<std::string, std::string> g_users = {{"bench", "bench"}};
+
+    const long g_delayUs = []
+    {
+        const char *env = getenv("STUB_SQL_DELAY_US");
+        return env ? atol(env) : 0L;
+    }();
+
+    const char *const g_downFile = getenv("STUB_SQL_DOWN_FILE");
+    long g_epoch = 0;     // "数据库"每重启一次加一
+    bool g_down = false;
+
+    // 当前的数据库纪元，不可达时返回-1。调用时须持有g_mtx
+    long Epoch()
+    {
+        if (g_downFile && access(g_downFile, F_OK) == 0)
+        {
+            g_down = true;
+            return -1;
+        }
+        if (g_down)
+        {
+            g_down = false;
+            g_epoch++;
+        }
+        return g_epoch;
+    }
+
+    struct StubConn
+    {
+        long epoch = -1; // 建连时的纪元，与当前不同即已断开
+        unsigned int err = 0;
+    };
+
+    StubConn *Conn(MYSQL *mysql)
+    {
+        return reinterpret_cast<StubConn *>(mysql);
+    }
+
+    struct StubStmt
+    {
+        StubConn *conn = nullptr;
+        bool isInsert = false;
+        bool isIndexCheck = false; // 启动时检查唯一键的查询，桩里的用户表按用户名唯一
+        int paramCnt = 0;
+        std::vector<std::string> params;
+        MYSQL_BIND *result = nullptr;
+        std::vector<std::pair<std::string, std::string>> rows; // 执行后待取的(username, password)
+        size_t next = 0;
+        unsigned int err = 0;
+    };
+
+    StubStmt *Stub(MYSQL_STMT *stmt)
+    {
+        return reinterpret_cast<StubStmt *>(stmt);
+    }
+
+    void Store(MYSQL_BIND &bind, const std::string &value, bool &truncated)
+    {
+        *bind.length = value.size();
+        size_t n = std::min<size_t>(value.size(), bind.buffer_length);
+        memcpy(bind.buffer, value.data(), n);
+        truncated = truncated || n < value.size();
+    }
+}
+
+extern "C"
+{
+    // 服务器总是以mysql_init(nullptr)建连，这里不支持传入调用者分配的MYSQL
+    MYSQL *mysql_init(MYSQL *)
+    {
+        return reinterpret_cast<MYSQL *>(new StubConn());
+    }
+
+    int mysql_options(MYSQL *, enum mysql_option, const void *)
+    {
+        return 0;
+    }
+
+    MYSQL *mysql_real_connect(MYSQL *mysql, const char *, const char *, const char *, const char *,
+                              unsigned int, const char *, unsigned long)
+    {
+        std::lock_guard<std::mutex> locker(g_mtx);
+        Conn(mysql)->epoch = Epoch();
+        Conn(mysql)->err = Conn(mysql)->epoch < 0 ? CR_CONN_HOST_ERROR : 0;
+        return Conn(mysql)->epoch < 0 ? nullptr : mysql;
+    }
+
+    int mysql_ping(MYSQL *mysql)
+    {
+        std::lock_guard<std::mutex> locker(g_mtx);
+        Conn(mysql)->err = Conn(mysql)->epoch == Epoch() ? 0 : CR_SERVER_GONE_ERROR;
+        return Conn(mysql)->err ? 1 : 0;
+    }
+
+    unsigned int mysql_errno(MYSQL *mysql)
+    {
+        return Conn(mysql)->err;
+    }
+
+    const char *mysql_error(MYSQL *mysql)
+    {
+        return Conn(mysql)->err ? "MySQL server has gone away" : "";
+    }
+
+    void mysql_close(MYSQL *mysql)
+    {
+        delete Conn(mysql);
+    }
+
+    void mysql_library_end(void)
+    {
+    }
+
+    MYSQL_STMT *mysql_stmt_init(MYSQL *mysql)
+    {
+        StubStmt *s = new StubStmt();
+        s->conn = Conn(mysql);
+        return reinterpret_cast<MYSQL_STMT *>(s);
+    }
+
+    int mysql_stmt_prepare(MYSQL_STMT *stmt, const char *query, unsigned long length)
+    {
+        std::string sql(query, length);
+        StubStmt *s = Stub(stmt);
+        s->isInsert = sql.compare(0, 6, "INSERT") == 0;
+        if (!s->isInsert && sql.compare(0, 6, "SELECT") != 0)
+        {
+            return 1;
+        }
+        s->isIndexCheck = sql.find("information_schema.STATISTICS") != std::string::npos;
+        s->paramCnt = std::count(sql.begin(), sql.end(), '?');
+        return 0;
+    }
+
+    bool mysql_stmt_bind_param(MYSQL_STMT *stmt, MYSQL_BIND *bind)
+    {
+        StubStmt *s = Stub(stmt);
+        s->params.clear();
+        for (int i = 0; i < s->paramCnt; ++i)
+        {
+            s->params.emplace_back(static_cast<const char *>(bind[i].buffer), *bind[i].length);
+        }
+        return false;
+    }
+
+    bool mysql_stmt_bind_result(MYSQL_STMT *stmt, MYSQL_BIND *bind)
+    {
+        Stub(stmt)->result = bind;
+        return false;
+    }
+
+    int mysql_stmt_execute(MYSQL_STMT *stmt)
+    {
+        if (g_delayUs > 0)
+        {
+            usleep(g_delayUs);
+        }
+        StubStmt *s = Stub(stmt);
+        s->rows.clear();
+        s->next = 0;
+        s->err = 0;
+        std::lock_guard<std::mutex> locker(g_mtx);
+        if (s->conn->epoch != Epoch())
+        {
+            s->err = CR_SERVER_LOST;
+            return 1;
+        }
+        if (s->isInsert)
+        {
+            if (!g_users.emplace(s->params[0], s->params[1]).second)
+            {
+                s->err = ER_DUP_ENTRY;
+                return 1;
+            }
+            return 0;
+        }
+        if (s->isIndexCheck)
+        {
+            s->rows.emplace_back("PRIMARY", "username");
+            return 0;
+        }
+        // IN列表里可能有重复的名字，每个用户只返回一行
+        for (size_t i = 0; i < s->params.size(); ++i)
+        {
+            auto first = s->params.begin() + i;
+            auto it = g_users.find(s->params[i]);
+            if (it != g_users.end() && std::find(s->params.begin(), first, s->params[i]) == first)
+            {
+                s->rows.emplace_back(it->first, it->second);
+            }
+        }
+        return 0;
+    }
+
+    int mysql_stmt_store_result(MYSQL_STMT *)
+    {
+        return 0;
+    }
+
+    int mysql_stmt_fetch(MYSQL_STMT *stmt)
+    {
+        StubStmt *s = Stub(stmt);
+        if (s->next >= s->rows.size())
+        {
+            return MYSQL_NO_DATA;
+        }
+        bool truncated = false;
+        Store(s->result[0], s->rows[s->next].first, truncated);
+        Store(s->result[1], s->rows[s->next].second, truncated);
+        ++s->next;
+        return truncated ? MYSQL_DATA_TRUNCATED : 0;
+    }
+
+    bool mysql_stmt_free_result(MYSQL_STMT *stmt)
+    {
+        Stub(stmt)->rows.clear();
+        return false;
+    }
+
+    bool mysql_stmt_reset(MYSQL_STMT *stmt)
+    {
+        return mysql_stmt_free_result(stmt);
+    }
+
+    bool mysql_stmt_close(MYSQL_STMT *stmt)
+    {
+        delete Stub(stmt);
+        return false;
+    }
+
+    unsigned int mysql_stmt_errno(MYSQL_STMT *stmt)
+    {
+        return Stub(stmt)->err;
+    }
+
+    const char *mysql_stmt_error(MYSQL_STMT *stmt)
+    {
+        return Stub(stmt)->err == ER_DUP_ENTRY ? "Duplicate entry" : (Stub(stmt)->err ? "Lost connection" : "");
+    }
+}
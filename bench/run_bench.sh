@@ -0,0 +1,82 @@
+#!/bin/bash
+# 用bench_server(桩用户表)跑全部压测场景，输出一个JSON文档：
+#   {"commit": ..., "date": ..., "results": [每个场景loadgen输出的一行JSON, ...]}
+# 默认写到results/<commit>.json，可用OUT指定；DURATION/WARMUP/CONNS/THREADS/IDLE_LEVELS可覆盖默认参数。
+# SQL_DELAY_US为桩用户表每次执行的模拟往返延迟。
+set -e
+cd "$(dirname "$0")"
+BENCH_DIR=$(pwd)
+BIN=$BENCH_DIR/../bin
+PORT=1316
+DURATION=${DURATION:-5}
+WARMUP=${WARMUP:-1}
+CONNS=${CONNS:-64}
+THREADS=${THREADS:-0}
+IDLE_LEVELS=${IDLE_LEVELS:-"0 1000 10000"}
+LARGE_MB=${LARGE_MB:-8}
+SQL_DELAY_US=${SQL_DELAY_US:-200}
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD -- ../src 2>/dev/null; then
+    COMMIT="$COMMIT-dirty"
+fi
+mkdir -p results
+OUT=${OUT:-results/$COMMIT.json}
+
+# 服务器以工作目录下的resources为根目录，在临时目录里准备一份并生成大文件
+WORK=$(mktemp -d)
+cp -r ../resources "$WORK/"
+head -c $((LARGE_MB * 1024 * 1024)) /dev/urandom > "$WORK/resources/bench-large.bin"
+
+ulimit -n 65536 2>/dev/null || ulimit -n "$(ulimit -Hn)"
+(cd "$WORK" && STUB_SQL_DELAY_US=$SQL_DELAY_US exec "$BIN/bench_server" > server.out 2>&1) &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null; rm -rf "$WORK"' EXIT
+
+for _ in $(seq 50); do
+    if (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+RESULTS=()
+run() {
+    local line
+    line=$("$BIN/loadgen" -p $PORT -d "$DURATION" -w "$WARMUP" -t "$THREADS" -P $SERVER_PID "$@")
+    echo "$line" >&2
+    RESULTS+=("$line")
+}
+
+run -n static_small -c "$CONNS" -u /index.html
+run -n static_css -c "$CONNS" -u /css/bootstrap.min.css
+run -n static_css_gzip -c "$CONNS" -A "Accept-Encoding: gzip" -u /css/bootstrap.min.css
+# 浏览器带着缓存回源校验：文件都是刚拷贝的，当前时间作If-Modified-Since必然命中304
+run -n static_css_304 -c "$CONNS" -A "If-Modified-Since: $(LC_ALL=C date -u '+%a, %d %b %Y %H:%M:%S GMT')" -u /css/bootstrap.min.css
+run -n static_large -c $((CONNS / 4 > 0 ? CONNS / 4 : 1)) -u /bench-large.bin
+# 播放器拖动进度条：从大文件中间取1MB
+run -n static_large_range -c $((CONNS / 4 > 0 ? CONNS / 4 : 1)) -A "Range: bytes=$((LARGE_MB * 512 * 1024))-$((LARGE_MB * 512 * 1024 + 1024 * 1024 - 1))" -u /bench-large.bin
+run -n not_found -c "$CONNS" -u /does-not-exist.html
+# 几个大文件下载同时在跑时小页面的延迟：后台持续拉大文件，前台测小页面，看p99是否被大响应拖长
+"$BIN/loadgen" -p $PORT -d $((DURATION + WARMUP + 1)) -w 0 -t 1 -n background_large -c 8 -u /bench-large.bin > /dev/null &
+BG_PID=$!
+run -n static_small_under_large -c "$CONNS" -u /index.html
+wait $BG_PID
+# 同一个用户反复登录，除第一次外都命中用户缓存；重名注册每次都要查库，作为对照
+run -n login_post -c "$CONNS" -m POST -u /login -b "username=bench&password=bench"
+run -n login_unknown -c "$CONNS" -m POST -u /login -b "username=nobody&password=bench"
+run -n register_dup -c "$CONNS" -m POST -u /register -b "username=bench&password=bench"
+run -n static_small_close -c "$CONNS" -C -u /index.html
+for idle in $IDLE_LEVELS; do
+    run -n "idle_$idle" -c 16 -i "$idle" -u /index.html
+done
+
+{
+    printf '{"commit":"%s","date":"%s","results":[\n' "$COMMIT" "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    for i in "${!RESULTS[@]}"; do
+        [ "$i" -gt 0 ] && printf ',\n'
+        printf '%s' "${RESULTS[$i]}"
+    done
+    printf '\n]}\n'
+} > "$OUT"
+echo "results written to $BENCH_DIR/$OUT" >&2
@@ -1,7 +1,9 @@
 #include "Buffer.hpp"
 
 Buffer::Buffer(size_t init_size)
-    : _buffer(init_size),
+    : _buffer(new char[init_size]),
+      _capacity(init_size),
+      _init_size(init_size),
       _read_pos(0),
       _write_pos(0)
 {
@@ -12,7 +14,7 @@ Buffer::Buffer(size_t init_size)
 
 size_t Buffer::WritableBytes() const
 {
-    return _buffer.size() - _write_pos;
+    return _capacity - _write_pos;
 }
 
 size_t Buffer::ReadableBytes() const
@@ -25,9 +27,45 @@ size_t Buffer::PrependableBytes() const
     return _read_pos;
 }
 
+size_t Buffer::Capacity() const
+{
+    return _capacity;
+}
+
 const char *Buffer::Peek() const
 {
-    return &_buffer[_read_pos];
+    return _Begin_Ptr() + _read_pos;
+}
+
+std::string_view Buffer::PeekView() const
+{
+    return std::string_view(Peek(), ReadableBytes());
+}
+
+const char *Buffer::FindCRLF() const
+{
+    return FindCRLF(Peek());
+}
+
+// glibc的memchr按SSE2/AVX2向量化，按16/32字节一组扫描'\r'，比逐字节比较或std::search快得多
+const char *Buffer::FindCRLF(const char *start) const
+{
+    assert(Peek() <= start && start <= BeginWriteConst());
+    const char *end = BeginWriteConst();
+    while (start < end)
+    {
+        const char *cr = static_cast<const char *>(memchr(start, '\r', end - start));
+        if (!cr || cr + 1 >= end)
+        {
+            return nullptr;
+        }
+        if (cr[1] == '\n')
+        {
+            return cr;
+        }
+        start = cr + 1;
+    }
+    return nullptr;
 }
 
 void Buffer::EnsureWriteable(size_t len)
@@ -64,11 +102,11 @@ void Buffer::RetrieveUntil(const char *end)
     Retrieve(end - Peek());
 }
 
+// 只复位下标，旧数据不清零
 void Buffer::RetrieveAll()
 {
     _read_pos = 0;
     _write_pos = 0;
-    bzero(&_buffer[0], _buffer.size());
 }
 
 std::string Buffer::RetrieveAllToStr()
@@ -78,22 +116,30 @@ std::string Buffer::RetrieveAllToStr()
     return str;
 }
 
+void Buffer::ShrinkToFit()
+{
+    if (_capacity > _init_size && ReadableBytes() <= _init_size)
+    {
+        _Reallocate(_init_size);
+    }
+}
+
 const char *Buffer::BeginWriteConst() const
 {
-    return &_buffer[_write_pos];
+    return _Begin_Ptr() + _write_pos;
 }
 
 char *Buffer::BeginWrite()
 {
-    return &_buffer[_write_pos];
+    return _Begin_Ptr() + _write_pos;
 }
 
 void Buffer::Append(const char *str, size_t len)
 {
     assert(str);
-    EnsureWriteable(len);                    // 确保可写的长度
-    std::copy(str, str + len, BeginWrite()); // 将str放到写下标开始的地方
-    HasWritten(len);                         // 移动写下标
+    EnsureWriteable(len);            // 确保可写的长度
+    memcpy(BeginWrite(), str, len);  // 将str放到写下标开始的地方
+    HasWritten(len);                 // 移动写下标
 }
 
 void Buffer::Append(const void *data, size_t len)
@@ -112,17 +158,28 @@ void Buffer::Append(const Buffer &buff)
     Append(buff.Peek(), buff.ReadableBytes());
 }
 
+// 缓冲区剩余空间不够时，多出来的数据先读进本线程共享的溢出区再追加，
+// 一次readv就能读完内核里积攒的数据，又不用每次调用都在栈上放64KB数组
 ssize_t Buffer::ReadFd(int fd, int *Errno)
 {
-    char buff[65535];
+    static thread_local std::unique_ptr<char[]> extra;
     struct iovec iov[2];
     const size_t writable = WritableBytes();
     iov[0].iov_base = BeginWrite();
     iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    int iovcnt = 1;
+    if (writable < EXTRA_BUFF_SIZE)
+    {
+        if (!extra)
+        {
+            extra.reset(new char[EXTRA_BUFF_SIZE]);
+        }
+        iov[1].iov_base = extra.get();
+        iov[1].iov_len = EXTRA_BUFF_SIZE;
+        iovcnt = 2;
+    }
 
-    const ssize_t len = readv(fd, iov, 2);
+    const ssize_t len = readv(fd, iov, iovcnt);
     if (len < 0)
     {
         *Errno = errno;
@@ -133,8 +190,8 @@ ssize_t Buffer::ReadFd(int fd, int *Errno)
     }
     else
     {
-        _write_pos = _buffer.size();
-        Append(buff, len - writable);
+        _write_pos = _capacity;
+        Append(extra.get(), len - writable);
     }
     return len;
 }
@@ -154,24 +211,43 @@ ssize_t Buffer::WriteFd(int fd, int *Errno)
 
 char *Buffer::_Begin_Ptr()
 {
-    return &_buffer[0];
+    return _buffer.get();
 }
 
 const char *Buffer::_Begin_Ptr() const
 {
-    return &_buffer[0];
+    return _buffer.get();
+}
+
+// 换一块capacity大小的内存，未读数据挪到开头
+void Buffer::_Reallocate(size_t capacity)
+{
+    size_t readable = ReadableBytes();
+    assert(readable <= capacity);
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    memcpy(buffer.get(), Peek(), readable);
+    _buffer = std::move(buffer);
+    _capacity = capacity;
+    _read_pos = 0;
+    _write_pos = readable;
 }
 
 void Buffer::_MakeSpace(size_t len)
 {
+    size_t readable = ReadableBytes();
     if (WritableBytes() + PrependableBytes() < len)
     {
-        _buffer.resize(_write_pos + len + 1);
+        // 按两倍扩容，连续追加时均摊O(1)
+        size_t capacity = _capacity ? _capacity : 1;
+        while (capacity < readable + len)
+        {
+            capacity <<= 1;
+        }
+        _Reallocate(capacity);
     }
     else
     {
-        size_t readable = ReadableBytes();
-        std::copy(_Begin_Ptr() + _read_pos, _Begin_Ptr() + _write_pos, _Begin_Ptr());
+        memmove(_Begin_Ptr(), Peek(), readable);
         _read_pos = 0;
         _write_pos = readable;
         assert(readable == ReadableBytes());
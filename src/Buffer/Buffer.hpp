@@ -3,24 +3,32 @@
 
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/uio.h>
-#include <vector>
-#include <atomic>
 #include <assert.h>
 
+// 连接独占的读写缓冲，不跨线程共享，下标用普通整数。
+// 空间不够时先把未读数据挪到开头，仍不够再按两倍扩容；连接空闲时可以ShrinkToFit还回多余的内存。
 class Buffer
 {
 private:
     char *_Begin_Ptr();
     const char *_Begin_Ptr() const;
     void _MakeSpace(size_t len);
+    void _Reallocate(size_t capacity);
 
-    std::vector<char> _buffer;
-    std::atomic<std::size_t> _read_pos;
-    std::atomic<std::size_t> _write_pos;
+    static const size_t EXTRA_BUFF_SIZE = 65536;
+
+    std::unique_ptr<char[]> _buffer;
+    size_t _capacity;
+    size_t _init_size;
+    size_t _read_pos;
+    size_t _write_pos;
 
 public:
     Buffer(size_t init_size = 1024);
@@ -29,8 +37,14 @@ public:
     size_t WritableBytes() const;
     size_t ReadableBytes() const;
     size_t PrependableBytes() const;
+    size_t Capacity() const;
 
     const char *Peek() const;
+    std::string_view PeekView() const;
+    // 从start(默认为可读数据开头)开始查找"\r\n"，没找到返回nullptr
+    const char *FindCRLF() const;
+    const char *FindCRLF(const char *start) const;
+
     void EnsureWriteable(size_t len);
     void HasWritten(size_t len);
 
@@ -39,6 +53,8 @@ public:
 
     void RetrieveAll();
     std::string RetrieveAllToStr();
+    // 可读数据不超过初始大小时把容量缩回初始大小
+    void ShrinkToFit();
 
     const char *BeginWriteConst() const;
     char *BeginWrite();
@@ -52,4 +68,4 @@ public:
     ssize_t WriteFd(int fd, int *Errno);
 };
 
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
@@ -0,0 +1,161 @@
+#include "ChainBuffer.hpp"
+
+namespace
+{
+    // 每个线程缓存一些空闲块，块可以在一个线程分配、在另一个线程释放，超过上限的直接还给系统
+    struct ChunkPool
+    {
+        static const size_t MAX_FREE = 256;
+        void *head = nullptr;
+        size_t count = 0;
+
+        ~ChunkPool()
+        {
+            while (head)
+            {
+                void *next = *static_cast<void **>(head);
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    };
+
+    thread_local ChunkPool pool;
+}
+
+ChainBuffer::Chunk *ChainBuffer::AllocChunk_()
+{
+    void *mem = pool.head;
+    if (mem)
+    {
+        pool.head = *static_cast<void **>(mem);
+        pool.count--;
+    }
+    else
+    {
+        mem = ::operator new(sizeof(Chunk));
+    }
+    Chunk *chunk = static_cast<Chunk *>(mem);
+    chunk->next = nullptr;
+    chunk->read = chunk->write = 0;
+    return chunk;
+}
+
+void ChainBuffer::FreeChunk_(Chunk *chunk)
+{
+    if (pool.count >= ChunkPool::MAX_FREE)
+    {
+        ::operator delete(chunk);
+        return;
+    }
+    *reinterpret_cast<void **>(chunk) = pool.head;
+    pool.head = chunk;
+    pool.count++;
+}
+
+ChainBuffer::ChainBuffer()
+    : _head(nullptr), _tail(nullptr), _readable(0), _chunkCnt(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    RetrieveAll();
+}
+
+size_t ChainBuffer::ReadableBytes() const
+{
+    return _readable;
+}
+
+size_t ChainBuffer::ChunkCount() const
+{
+    return _chunkCnt;
+}
+
+void ChainBuffer::Append(const std::string &str)
+{
+    Append(str.data(), str.size());
+}
+
+void ChainBuffer::Append(const void *data, size_t len)
+{
+    assert(data);
+    Append(static_cast<const char *>(data), len);
+}
+
+void ChainBuffer::Append(const char *str, size_t len)
+{
+    assert(str || len == 0);
+    _readable += len;
+    while (len > 0)
+    {
+        if (!_tail || _tail->write == CHUNK_SIZE)
+        {
+            Chunk *chunk = AllocChunk_();
+            if (_tail)
+            {
+                _tail->next = chunk;
+            }
+            else
+            {
+                _head = chunk;
+            }
+            _tail = chunk;
+            _chunkCnt++;
+        }
+        size_t n = CHUNK_SIZE - _tail->write < len ? CHUNK_SIZE - _tail->write : len;
+        memcpy(_tail->data + _tail->write, str, n);
+        _tail->write += n;
+        str += n;
+        len -= n;
+    }
+}
+
+// 取完的块立即归还块池
+void ChainBuffer::Retrieve(size_t len)
+{
+    assert(len <= _readable);
+    _readable -= len;
+    while (len > 0)
+    {
+        size_t size = _head->write - _head->read;
+        if (len < size)
+        {
+            _head->read += len;
+            break;
+        }
+        len -= size;
+        Chunk *next = _head->next;
+        FreeChunk_(_head);
+        _chunkCnt--;
+        _head = next;
+    }
+    if (!_head)
+    {
+        _tail = nullptr;
+    }
+}
+
+void ChainBuffer::RetrieveAll()
+{
+    while (_head)
+    {
+        Chunk *next = _head->next;
+        FreeChunk_(_head);
+        _head = next;
+    }
+    _tail = nullptr;
+    _readable = 0;
+    _chunkCnt = 0;
+}
+
+std::string ChainBuffer::RetrieveAllToStr()
+{
+    std::string str;
+    str.reserve(_readable);
+    ForEachSegment(0, _readable, [&str](const char *data, size_t len)
+                   { str.append(data, len); });
+    RetrieveAll();
+    return str;
+}
@@ -0,0 +1,73 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <cstring>
+#include <string>
+#include <assert.h>
+
+// 由定长块串成的缓冲：追加只会在链尾写入或挂一个新块，已有数据永远不会被搬动，
+// 内存按块增长，取完的块归还给本线程的块池，连接空闲时不占用任何块。
+// 用于拼装响应头和生成的错误页，HttpConn按块切成iovec直接writev出去。
+class ChainBuffer
+{
+public:
+    static const size_t CHUNK_SIZE = 4096;
+
+    ChainBuffer();
+    ~ChainBuffer();
+    ChainBuffer(const ChainBuffer &) = delete;
+    ChainBuffer &operator=(const ChainBuffer &) = delete;
+
+    size_t ReadableBytes() const;
+    size_t ChunkCount() const;
+
+    void Append(const std::string &str);
+    void Append(const char *str, size_t len);
+    void Append(const void *data, size_t len);
+
+    void Retrieve(size_t len);
+    void RetrieveAll();
+    std::string RetrieveAllToStr();
+
+    // 依次对[offset, offset + len)范围内每个块上的连续片段调用f(const char *, size_t)
+    template <typename F>
+    void ForEachSegment(size_t offset, size_t len, F &&f) const;
+
+private:
+    struct Chunk
+    {
+        Chunk *next;
+        size_t read;
+        size_t write;
+        char data[CHUNK_SIZE];
+    };
+
+    static Chunk *AllocChunk_();
+    static void FreeChunk_(Chunk *chunk);
+
+    Chunk *_head;
+    Chunk *_tail;
+    size_t _readable;
+    size_t _chunkCnt;
+};
+
+template <typename F>
+void ChainBuffer::ForEachSegment(size_t offset, size_t len, F &&f) const
+{
+    assert(offset + len <= _readable);
+    for (Chunk *chunk = _head; chunk && len > 0; chunk = chunk->next)
+    {
+        size_t size = chunk->write - chunk->read;
+        if (offset >= size)
+        {
+            offset -= size;
+            continue;
+        }
+        size_t n = size - offset < len ? size - offset : len;
+        f(chunk->data + chunk->read + offset, n);
+        len -= n;
+        offset = 0;
+    }
+}
+
+#endif // CHAIN_BUFFER_H
@@ -13,11 +13,13 @@ public:
     explicit Epoller(int maxEvent = 1024);
     ~Epoller();
 
-    bool AddFd(int fd, uint32_t events);
-    bool ModFd(int fd, uint32_t events);
+    // 事件数据里fd放低32位、gen放高32位，连接关闭后fd被复用时可以据此识别过期事件
+    bool AddFd(int fd, uint32_t events, uint32_t gen = 0);
+    bool ModFd(int fd, uint32_t events, uint32_t gen = 0);
     bool DelFd(int fd);
     int Wait(int timeoutMs = -1);
     int GetEventFd(size_t i) const;
+    uint32_t GetEventGen(size_t i) const;
     uint32_t GetEvents(size_t i) const;
 
 private:
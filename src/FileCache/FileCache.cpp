@@ -0,0 +1,256 @@
+#include "FileCache.hpp"
+
+FileCache::FileCache()
+    : _shardBytes(0),
+      _maxFileSize(0),
+      _revalidateMs(1000),
+      _isOpen(false),
+      _hits(0),
+      _misses(0)
+{
+}
+
+FileCache *FileCache::Instance()
+{
+    static FileCache instance;
+    return &instance;
+}
+
+void FileCache::Init(size_t maxBytes, size_t maxFileSize, int revalidateMs, int shardNum)
+{
+    assert(shardNum > 0);
+    _shards.clear();
+    for (int i = 0; i < shardNum; ++i)
+    {
+        _shards.emplace_back(new Shard());
+    }
+    _shardBytes = maxBytes / shardNum;
+    // 单个文件不能超过一个分片的预算，否则刚插入就会被淘汰
+    _maxFileSize = std::min(maxFileSize, _shardBytes);
+    _revalidateMs = revalidateMs;
+    _isOpen = maxBytes > 0;
+}
+
+bool FileCache::IsOpen() const
+{
+    return _isOpen;
+}
+
+size_t FileCache::MaxFileSize() const
+{
+    return _maxFileSize;
+}
+
+FileCache::EntryPtr FileCache::Get(const std::string &path)
+{
+    if (!_isOpen)
+    {
+        return nullptr;
+    }
+    Shard &shard = ShardOf_(path);
+    EntryPtr entry;
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end())
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            entry = *it->second;
+        }
+    }
+    if (!entry)
+    {
+        _misses++;
+        return nullptr;
+    }
+
+    int64_t now = NowMs_();
+    if (now - entry->checkedMs.load(std::memory_order_relaxed) >= _revalidateMs)
+    {
+        if (Stale_(*entry))
+        {
+            LOG_DEBUG("FileCache: %s changed, drop", path.c_str());
+            std::lock_guard<std::mutex> locker(shard.mtx);
+            auto it = shard.index.find(path);
+            if (it != shard.index.end() && *it->second == entry)
+            {
+                Remove_(shard, path);
+            }
+            _misses++;
+            return nullptr;
+        }
+        entry->checkedMs.store(now, std::memory_order_relaxed);
+    }
+    _hits++;
+    return entry;
+}
+
+FileCache::EntryPtr FileCache::Load(const std::string &path, int fd, const struct stat &st, const HeaderBuilder &builder,
+                                   bool compressible)
+{
+    if (!_isOpen || !S_ISREG(st.st_mode) || static_cast<size_t>(st.st_size) > _maxFileSize)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->path = path;
+    entry->body.resize(st.st_size);
+    size_t done = 0;
+    while (done < entry->body.size())
+    {
+        ssize_t len = pread(fd, &entry->body[done], entry->body.size() - done, done);
+        if (len <= 0)
+        {
+            // 读的过程中文件被截断，不缓存，交给调用者按原路径处理
+            return nullptr;
+        }
+        done += len;
+    }
+    entry->header[0] = builder(false, false, entry->body.size());
+    entry->header[1] = builder(true, false, entry->body.size());
+    // 压缩后至少省下十分之一才保留gzip版本
+    if (compressible && entry->body.size() >= GZIP_MIN_SIZE && Gzip_(entry->body, entry->gzBody) &&
+        entry->gzBody.size() < entry->body.size() / 10 * 9)
+    {
+        entry->gzHeader[0] = builder(false, true, entry->gzBody.size());
+        entry->gzHeader[1] = builder(true, true, entry->gzBody.size());
+    }
+    else
+    {
+        entry->gzBody.clear();
+    }
+    entry->mtime = st.st_mtim;
+    entry->size = st.st_size;
+    entry->ino = st.st_ino;
+    entry->checkedMs = NowMs_();
+
+    Shard &shard = ShardOf_(path);
+    {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        Insert_(shard, entry);
+    }
+    return entry;
+}
+
+void FileCache::Erase(const std::string &path)
+{
+    if (!_isOpen)
+    {
+        return;
+    }
+    Shard &shard = ShardOf_(path);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    Remove_(shard, path);
+}
+
+void FileCache::Clear()
+{
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        shard->index.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
+
+size_t FileCache::Bytes()
+{
+    size_t bytes = 0;
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        bytes += shard->bytes;
+    }
+    return bytes;
+}
+
+uint64_t FileCache::Hits() const
+{
+    return _hits;
+}
+
+uint64_t FileCache::Misses() const
+{
+    return _misses;
+}
+
+FileCache::Shard &FileCache::ShardOf_(const std::string &path)
+{
+    return *_shards[std::hash<std::string>()(path) % _shards.size()];
+}
+
+void FileCache::Insert_(Shard &shard, EntryPtr entry)
+{
+    Remove_(shard, entry->path);
+    shard.lru.push_front(entry);
+    shard.index[entry->path] = shard.lru.begin();
+    shard.bytes += Cost_(*entry);
+    while (shard.bytes > _shardBytes && !shard.lru.empty())
+    {
+        Remove_(shard, shard.lru.back()->path);
+    }
+}
+
+void FileCache::Remove_(Shard &shard, const std::string &path)
+{
+    auto it = shard.index.find(path);
+    if (it == shard.index.end())
+    {
+        return;
+    }
+    shard.bytes -= Cost_(**it->second);
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+}
+
+bool FileCache::Stale_(const Entry &entry) const
+{
+    struct stat st;
+    if (stat(entry.path.c_str(), &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH))
+    {
+        return true;
+    }
+    return st.st_size != entry.size || st.st_ino != entry.ino ||
+           st.st_mtim.tv_sec != entry.mtime.tv_sec || st.st_mtim.tv_nsec != entry.mtime.tv_nsec;
+}
+
+size_t FileCache::Cost_(const Entry &entry)
+{
+    return entry.body.size() + entry.header[0].size() + entry.header[1].size() + entry.path.size() +
+           entry.gzBody.size() + entry.gzHeader[0].size() + entry.gzHeader[1].size();
+}
+
+// 一次性压缩成gzip格式(windowBits加16)
+bool FileCache::Gzip_(const std::string &in, std::string &out)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END)
+    {
+        out.clear();
+        return false;
+    }
+    out.shrink_to_fit();
+    return true;
+}
+
+int64_t FileCache::NowMs_()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
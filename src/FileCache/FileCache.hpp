@@ -0,0 +1,93 @@
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include <string>
+#include <list>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <zlib.h>
+
+#include "../Log/Log.hpp"
+
+// 静态文件缓存：按解析后的绝对路径分片，每片一把锁 + LRU链表，总字节数受预算约束。
+// 条目保存文件内容和序列化好的响应头（keep-alive / close两种），命中时只需一次writev。
+// 条目在revalidateMs内直接返回，超过后重新stat一次，mtime/大小/inode变化则失效。
+// 可压缩的文件在载入时顺带生成gzip版本放在同一条目里，命中时按Accept-Encoding二选一，热路径上不做压缩。
+class FileCache
+{
+public:
+    struct Entry
+    {
+        std::string path;
+        std::string body;
+        std::string header[2]; // [0]: Connection: close, [1]: Connection: keep-alive
+        std::string gzBody;      // 为空表示没有gzip版本(不可压缩、太小或压缩后不够小)
+        std::string gzHeader[2];
+        struct timespec mtime;
+        off_t size;
+        ino_t ino;
+        mutable std::atomic<int64_t> checkedMs; // 上次校验的时间(steady clock)
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+    // 生成响应头，参数为keepAlive、是否gzip版本、正文长度
+    typedef std::function<std::string(bool, bool, size_t)> HeaderBuilder;
+
+    static const size_t GZIP_MIN_SIZE = 1024; // 更小的文件压缩省不了几个字节
+
+    static FileCache *Instance();
+
+    void Init(size_t maxBytes, size_t maxFileSize = 1024 * 1024, int revalidateMs = 1000, int shardNum = 16);
+    bool IsOpen() const;
+    size_t MaxFileSize() const;
+
+    EntryPtr Get(const std::string &path);
+    EntryPtr Load(const std::string &path, int fd, const struct stat &st, const HeaderBuilder &builder,
+                  bool compressible = false);
+    void Erase(const std::string &path);
+    void Clear();
+
+    size_t Bytes();
+    uint64_t Hits() const;
+    uint64_t Misses() const;
+
+private:
+    FileCache();
+    ~FileCache() = default;
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::list<EntryPtr> lru; // 表头最近使用
+        std::unordered_map<std::string, std::list<EntryPtr>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard &ShardOf_(const std::string &path);
+    void Insert_(Shard &shard, EntryPtr entry);
+    void Remove_(Shard &shard, const std::string &path);
+    bool Stale_(const Entry &entry) const;
+    static size_t Cost_(const Entry &entry);
+    static bool Gzip_(const std::string &in, std::string &out);
+    static int64_t NowMs_();
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    size_t _shardBytes;
+    size_t _maxFileSize;
+    int _revalidateMs;
+    bool _isOpen;
+
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+};
+
+#endif // FILECACHE_HPP
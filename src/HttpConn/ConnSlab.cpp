@@ -0,0 +1,46 @@
+#include "ConnSlab.hpp"
+
+ConnSlab::ConnSlab(int maxFd)
+    : _maxFd(maxFd),
+      _blocks(new std::atomic<HttpConn *>[(maxFd + BLOCK_SIZE - 1) / BLOCK_SIZE])
+{
+    assert(maxFd > 0);
+    for (int i = 0; i < (maxFd + BLOCK_SIZE - 1) / BLOCK_SIZE; ++i)
+    {
+        _blocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ConnSlab::~ConnSlab()
+{
+    for (int i = 0; i < (_maxFd + BLOCK_SIZE - 1) / BLOCK_SIZE; ++i)
+    {
+        delete[] _blocks[i].load(std::memory_order_relaxed);
+    }
+}
+
+HttpConn &ConnSlab::operator[](int fd)
+{
+    assert(fd >= 0 && fd < _maxFd);
+    std::atomic<HttpConn *> &slot = _blocks[fd / BLOCK_SIZE];
+    HttpConn *block = slot.load(std::memory_order_acquire);
+    if (!block)
+    {
+        // 两个Reactor同时分配同一块时，输掉的一方释放自己的
+        HttpConn *fresh = new HttpConn[BLOCK_SIZE];
+        if (slot.compare_exchange_strong(block, fresh, std::memory_order_acq_rel))
+        {
+            block = fresh;
+        }
+        else
+        {
+            delete[] fresh;
+        }
+    }
+    return block[fd % BLOCK_SIZE];
+}
+
+int ConnSlab::MaxFd() const
+{
+    return _maxFd;
+}
@@ -0,0 +1,32 @@
+#ifndef CONN_SLAB_HPP
+#define CONN_SLAB_HPP
+
+#include <atomic>
+#include <memory>
+#include <assert.h>
+
+#include "HttpConn.hpp"
+
+// 以fd为下标的连接表。fd在进程内唯一，所有Reactor共用一张表。
+// 连接对象按BLOCK_SIZE个一块分配，第一次用到某个fd区间时才分配对应的块，之后不再释放也不移动，
+// 因此定时器回调和线程池任务里保存的HttpConn指针一直有效。
+class ConnSlab
+{
+public:
+    static const int BLOCK_SIZE = 256;
+
+    explicit ConnSlab(int maxFd);
+    ~ConnSlab();
+    ConnSlab(const ConnSlab &) = delete;
+    ConnSlab &operator=(const ConnSlab &) = delete;
+
+    // fd所在的块不存在时分配，可以在多个线程并发调用
+    HttpConn &operator[](int fd);
+    int MaxFd() const;
+
+private:
+    const int _maxFd;
+    std::unique_ptr<std::atomic<HttpConn *>[]> _blocks;
+};
+
+#endif // CONN_SLAB_HPP
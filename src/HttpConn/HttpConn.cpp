@@ -3,8 +3,12 @@
 bool HttpConn::isET = false;
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount(0);
+size_t HttpConn::writeQuantum = 256 * 1024;
 
-HttpConn::HttpConn() : _fd(-1), _addr({0}), _isClose(true), _iovCnt(0) {}
+thread_local std::vector<std::unique_ptr<HttpConn::Context>> HttpConn::_freeContexts;
+
+HttpConn::HttpConn() : _fd(-1), _addr({0}), _isClose(true), _gen(0), _isKeepAlive(false), _auth(AUTH_IDLE), _iovIdx(0), _iovBytes(0),
+                       _sliceIdx(0), _sendLen(0), _ctx(nullptr) {}
 
 HttpConn::~HttpConn()
 {
@@ -18,17 +22,23 @@ void HttpConn::Init(int sockFd, const sockaddr_in &addr)
     _addr = addr;
     _fd = sockFd;
     _writeBuff.RetrieveAll();
-    _readBuff.RetrieveAll();
+    DetachContext_();
+    _iovIdx = _iovBytes = _sliceIdx = _sendLen = 0;
+    _isKeepAlive = false;
+    _auth.store(AUTH_IDLE, std::memory_order_relaxed);
     _isClose = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", _fd, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close()
 {
-    _response.UnmapFile();
+    DetachContext_();
+    _writeBuff.RetrieveAll();
     if (!_isClose)
     {
         _isClose = true;
+        _gen.fetch_add(1, std::memory_order_release); // 先作废旧的引用，close之后fd随时可能被新连接复用
+        _auth.store(AUTH_IDLE, std::memory_order_release);
         userCount--;
         close(_fd);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", _fd, GetIP(), GetPort(), (int)userCount);
@@ -40,6 +50,16 @@ int HttpConn::GetFd() const
     return _fd;
 }
 
+uint32_t HttpConn::Generation() const
+{
+    return _gen.load(std::memory_order_acquire);
+}
+
+std::mutex &HttpConn::Mutex()
+{
+    return _mtx;
+}
+
 const char *HttpConn::GetIP() const
 {
     return inet_ntoa(_addr.sin_addr);
@@ -55,93 +75,331 @@ sockaddr_in HttpConn::GetAddr() const
     return _addr;
 }
 
+HttpConn::Context *HttpConn::AcquireContext_()
+{
+    if (_freeContexts.empty())
+    {
+        return new Context();
+    }
+    Context *ctx = _freeContexts.back().release();
+    _freeContexts.pop_back();
+    return ctx;
+}
+
+// Context可以在一个线程取出、在另一个线程放回，超过上限的直接释放
+void HttpConn::ReleaseContext_(Context *ctx)
+{
+    if (_freeContexts.size() >= MAX_FREE_CONTEXT)
+    {
+        delete ctx;
+        return;
+    }
+    ctx->readBuff.RetrieveAll();
+    ctx->readBuff.ShrinkToFit();
+    ctx->request.Init();
+    ctx->iov.clear();
+    _freeContexts.emplace_back(ctx);
+}
+
+// 连接上没有在处理的请求时，把读缓冲、解析器和响应对象交还给池
+void HttpConn::DetachContext_()
+{
+    if (!_ctx)
+    {
+        return;
+    }
+    ReleaseResponses_();
+    ReleaseContext_(_ctx);
+    _ctx = nullptr;
+}
+
+size_t HttpConn::IdleBytes()
+{
+    return sizeof(HttpConn);
+}
+
+size_t HttpConn::ActiveBytes()
+{
+    Context ctx;
+    return sizeof(HttpConn) + sizeof(Context) + ctx.readBuff.Capacity() + sizeof(HttpResponse);
+}
+
 ssize_t HttpConn::Read(int *saveErrno)
 {
+    if (!_ctx)
+    {
+        _ctx = AcquireContext_();
+    }
+    StageTimer timer(Metrics::READ);
     ssize_t len = -1;
     do
     {
-        len = _readBuff.ReadFd(_fd, saveErrno);
+        len = _ctx->readBuff.ReadFd(_fd, saveErrno);
         if (len <= 0)
         {
             break;
         }
+        Metrics::Add(Metrics::BYTES_READ, len);
     } while (isET);
     return len;
 }
 
 ssize_t HttpConn::Write(int *saveErrno)
 {
+    if (!_ctx)
+    {
+        return 0;
+    }
+    StageTimer timer(Metrics::WRITE);
+    size_t toWrite = ToWriteBytes();
+    size_t budget = writeQuantum > 0 ? writeQuantum : SIZE_MAX; // 本轮还能写的字节数
     ssize_t len = -1;
     do
     {
-        len = writev(_fd, _iov, _iovCnt);
+        // writev发到下一个文件区间为止，再用sendfile发这个区间
+        size_t stop = _sliceIdx < _ctx->slices.size() ? _ctx->slices[_sliceIdx].iovPos : _ctx->iov.size();
+        if (_iovIdx == stop)
+        {
+            if (_sliceIdx == _ctx->slices.size())
+            {
+                len = 0;
+                break;
+            }
+            // EAGAIN时区间的off保留进度，下次EPOLLOUT接着发
+            Context::FileSlice &slice = _ctx->slices[_sliceIdx];
+            len = sendfile(_fd, slice.fd, &slice.off, std::min(slice.len, budget));
+            if (len <= 0)
+            {
+                *saveErrno = len < 0 ? errno : EIO; // 返回0说明文件被截断，无法再凑够Content-length
+                len = -1;
+                break;
+            }
+            slice.len -= len;
+            _sendLen -= len;
+            budget -= len;
+            if (slice.len == 0)
+            {
+                _sliceIdx++;
+            }
+            continue;
+        }
+        len = writev(_fd, &_ctx->iov[_iovIdx], std::min<size_t>(stop - _iovIdx, IOV_MAX));
         if (len <= 0)
         {
             *saveErrno = errno;
             break;
         }
-        if (_iov[0].iov_len + _iov[1].iov_len == 0)
+        _iovBytes -= len;
+        budget -= std::min<size_t>(len, budget);
+        size_t n = len;
+        while (n > 0 && n >= _ctx->iov[_iovIdx].iov_len)
         {
-            break;
+            n -= _ctx->iov[_iovIdx].iov_len;
+            _iovIdx++;
         }
-        else if (static_cast<size_t>(len) > _iov[0].iov_len)
+        if (n > 0)
         {
-            _iov[1].iov_base = (uint8_t *)_iov[1].iov_base + (len - _iov[0].iov_len);
-            _iov[1].iov_len -= (len - _iov[0].iov_len);
-            if (_iov[0].iov_len)
-            {
-                _writeBuff.RetrieveAll();
-                _iov[0].iov_len = 0;
-            }
+            _ctx->iov[_iovIdx].iov_base = (uint8_t *)_ctx->iov[_iovIdx].iov_base + n;
+            _ctx->iov[_iovIdx].iov_len -= n;
         }
-        else
+        if (_iovIdx == _ctx->iov.size())
         {
-            _iov[0].iov_base = (uint8_t *)_iov[0].iov_base + len;
-            _iov[0].iov_len -= len;
-            _writeBuff.Retrieve(len);
+            // 响应头都已发出，块归还块池
+            _writeBuff.RetrieveAll();
         }
-    } while (isET || ToWriteBytes() > 10240);
+    } while (ToWriteBytes() > 0 && budget > 0 && (isET || ToWriteBytes() > 10240));
+    if (budget == 0 && ToWriteBytes() > 0)
+    {
+        Metrics::Add(Metrics::WRITE_YIELDS);
+    }
+    Metrics::Add(Metrics::BYTES_WRITTEN, toWrite - ToWriteBytes());
     return len;
 }
 
+// 处理读缓冲中所有完整的请求(流水线)，响应头依次追加到_writeBuff，与正文交替组成iovec一次写出。
+// 返回false表示没有完整请求，需要继续读。
 bool HttpConn::process()
 {
-    _request.Init();
-    if (_readBuff.ReadableBytes() <= 0)
+    if (!_ctx)
     {
         return false;
     }
-    else if (_request.parse(_readBuff))
+    size_t headerEnd[MAX_PIPELINE];
+    ReleaseResponses_();
+    while (_ctx->respCnt < MAX_PIPELINE && _ctx->readBuff.ReadableBytes() > 0)
     {
-        LOG_DEBUG("%s", _request.path().c_str());
-        _response.Init(srcDir, _request.path(), _request.IsKeepAlive(), 200);
+        uint64_t begin = Metrics::NowNs();
+        HttpRequest::HTTP_CODE ret = _ctx->request.parse(_ctx->readBuff);
+        uint64_t parsed = Metrics::NowNs();
+        Metrics::Observe(Metrics::PARSE, parsed - begin);
+        if (ret == HttpRequest::NO_REQUEST)
+        {
+            break;
+        }
+        if (ret == HttpRequest::GET_REQUEST && _ctx->request.NeedsAuth())
+        {
+            // 查库结果还没有：前面的响应先发出去，没有前序响应时进入等待，这个请求留在读缓冲里下次重新parse(已是FINISH状态，直接返回)
+            uint8_t auth = _auth.load(std::memory_order_acquire);
+            if (auth == AUTH_IDLE || auth == AUTH_WAITING)
+            {
+                if (_ctx->respCnt == 0)
+                {
+                    _auth.store(AUTH_WAITING, std::memory_order_release);
+                }
+                break;
+            }
+            _auth.store(AUTH_IDLE, std::memory_order_relaxed);
+            _ctx->request.SetAuthResult(auth == AUTH_OK);
+        }
+        Metrics::Add(Metrics::REQUESTS);
+        HttpResponse &response = NextResponse_();
+        if (ret == HttpRequest::GET_REQUEST)
+        {
+            LOG_DEBUG("%s", _ctx->request.path().c_str());
+            HttpResponse::Negotiation neg = {};
+            neg.acceptGzip = _ctx->request.AcceptsEncoding("gzip");
+            if (_ctx->request.method() == "GET")
+            {
+                // 视图指向读缓冲，下面Retrieve之前有效，只在MakeResponse里用到
+                neg.ifNoneMatch = _ctx->request.GetHeader("If-None-Match");
+                neg.ifModifiedSince = _ctx->request.GetHeader("If-Modified-Since");
+                neg.range = _ctx->request.GetHeader("Range");
+                neg.ifRange = _ctx->request.GetHeader("If-Range");
+            }
+            response.Init(srcDir, _ctx->request.path(), _ctx->request.IsKeepAlive(), 200, neg);
+        }
+        else
+        {
+            response.Init(srcDir, _ctx->request.path(), false, 400);
+        }
+        if (ret == HttpRequest::GET_REQUEST && _ctx->request.path() == Metrics::PATH)
+        {
+            // 指标页直接在内存里生成，不经过文件系统
+            std::string body;
+            Metrics::Instance()->Render(body);
+            response.MakeContent(_writeBuff, body, Metrics::CONTENT_TYPE);
+        }
+        else
+        {
+            response.MakeResponse(_writeBuff);
+        }
+        Metrics::Observe(Metrics::BUILD, Metrics::NowNs() - parsed);
+        headerEnd[_ctx->respCnt - 1] = _writeBuff.ReadableBytes();
+        _isKeepAlive = (ret == HttpRequest::GET_REQUEST) && _ctx->request.IsKeepAlive();
+
+        // 请求头以视图形式引用读缓冲，响应生成完后再丢弃已解析的字节；出错的请求整体丢弃
+        _ctx->readBuff.Retrieve(ret == HttpRequest::GET_REQUEST ? _ctx->request.Consumed() : _ctx->readBuff.ReadableBytes());
+        _ctx->request.Init();
+        // 要关闭的连接不再处理后续请求
+        if (!_isKeepAlive)
+        {
+            break;
+        }
     }
-    else
+    if (_ctx->respCnt == 0)
     {
-        _response.Init(srcDir, _request.path(), false, 400);
+        // 没有半截请求也没有待发的响应，连接转为空闲(等待查库的请求还在读缓冲里)
+        if (_ctx->readBuff.ReadableBytes() == 0)
+        {
+            DetachContext_();
+        }
+        return false;
     }
 
-    _response.MakeResponse(_writeBuff);
-    _iov[0].iov_base = const_cast<char *>(_writeBuff.Peek());
-    _iov[0].iov_len = _writeBuff.ReadableBytes();
-    _iovCnt = 1;
-
-    if (_response.FileLen() > 0 && _response.File())
+    // 响应头按块切成iovec，块在发送完之前不会被搬动
+    _ctx->iov.clear();
+    _ctx->slices.clear();
+    _iovIdx = _iovBytes = 0;
+    _sliceIdx = _sendLen = 0;
+    size_t headerBegin = 0;
+    for (size_t i = 0; i < _ctx->respCnt; ++i)
     {
-        _iov[1].iov_base = _response.File();
-        _iov[1].iov_len = _response.FileLen();
-        _iovCnt = 2;
+        HttpResponse &response = *_ctx->responses[i];
+        _writeBuff.ForEachSegment(headerBegin, headerEnd[i] - headerBegin,
+                                  [this](const char *data, size_t len)
+                                  { AddIov_(data, len); });
+        headerBegin = headerEnd[i];
+        response.ForEachPiece([this](const char *data, size_t len)
+                              { AddIov_(data, len); },
+                              [this](int fd, off_t off, size_t len)
+                              { AddSlice_(fd, off, len); });
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", _response.FileLen(), _iovCnt, ToWriteBytes());
+    LOG_DEBUG("responses:%d, iov:%d, to %d", (int)_ctx->respCnt, (int)_ctx->iov.size(), (int)ToWriteBytes());
     return true;
 }
 
-int HttpConn::ToWriteBytes() const
+bool HttpConn::WaitingAuth() const
+{
+    return _auth.load(std::memory_order_acquire) == AUTH_WAITING;
+}
+
+void HttpConn::AuthQuery(std::string &name, std::string &pwd, bool &isLogin) const
 {
-    return _iov[0].iov_len + _iov[1].iov_len;
+    assert(_ctx);
+    name = _ctx->request.GetPost("username");
+    pwd = _ctx->request.GetPost("password");
+    isLogin = _ctx->request.IsLogin();
+}
+
+bool HttpConn::FinishAuth(bool ok)
+{
+    uint8_t waiting = AUTH_WAITING;
+    return _auth.compare_exchange_strong(waiting, ok ? AUTH_OK : AUTH_FAILED, std::memory_order_acq_rel);
+}
+
+size_t HttpConn::ToWriteBytes() const
+{
+    return _iovBytes + _sendLen;
 }
 
 bool HttpConn::IsKeepAlive() const
 {
-    return _request.IsKeepAlive();
-}
\ No newline at end of file
+    return _isKeepAlive;
+}
+
+HttpResponse &HttpConn::NextResponse_()
+{
+    if (_ctx->respCnt == _ctx->responses.size())
+    {
+        _ctx->responses.emplace_back(new HttpResponse());
+    }
+    return *_ctx->responses[_ctx->respCnt++];
+}
+
+void HttpConn::ReleaseResponses_()
+{
+    for (size_t i = 0; i < _ctx->respCnt; ++i)
+    {
+        _ctx->responses[i]->UnmapFile();
+    }
+    _ctx->respCnt = 0;
+}
+
+// 相邻的内存段(如连续的错误页响应都在_writeBuff里)合并成一个iovec，中间隔着文件区间的不合并
+void HttpConn::AddIov_(const void *base, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    bool afterSlice = !_ctx->slices.empty() && _ctx->slices.back().iovPos == _ctx->iov.size();
+    if (!_ctx->iov.empty() && !afterSlice && (const char *)_ctx->iov.back().iov_base + _ctx->iov.back().iov_len == base)
+    {
+        _ctx->iov.back().iov_len += len;
+    }
+    else
+    {
+        _ctx->iov.push_back({const_cast<void *>(base), len});
+    }
+    _iovBytes += len;
+}
+
+void HttpConn::AddSlice_(int fd, off_t off, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    _ctx->slices.push_back({_ctx->iov.size(), fd, off, len});
+    _sendLen += len;
+}
@@ -6,28 +6,79 @@
 #include <arpa/inet.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <limits.h>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 #include "../Log/Log.hpp"
 #include "../Buffer/Buffer.hpp"
+#include "../Buffer/ChainBuffer.hpp"
 #include "../HttpRequest/HttpRequest.hpp"
 #include "../HttpResponse/HttpResponse.hpp"
+#include "../Metrics/Metrics.hpp"
 
 class HttpConn
 {
 private:
+    // 只在有请求在处理时挂在连接上的状态，空闲的keep-alive连接不持有，用完放回本线程的池里复用
+    struct Context
+    {
+        Buffer readBuff;
+        HttpRequest request;
+        // 一批流水线请求的响应，写完之前要持有各自的正文(mmap/缓存条目/sendfile文件)
+        std::vector<std::unique_ptr<HttpResponse>> responses;
+        size_t respCnt = 0;
+        // 待发送的分段：各响应头(指向_writeBuff)与各自的正文交替排列，一次writev发出
+        std::vector<struct iovec> iov;
+        // 用sendfile发的文件区间，iovPos为它在iov中的位置：iov[iovPos]之前的分段发完后再发它
+        struct FileSlice
+        {
+            size_t iovPos;
+            int fd;
+            off_t off;
+            size_t len;
+        };
+        std::vector<FileSlice> slices;
+    };
+
     int _fd;
     struct sockaddr_in _addr;
 
     bool _isClose;
+    std::atomic<uint32_t> _gen; // 每关闭一次加一，定时器、线程池任务和epoll事件据此识别fd被复用后的过期引用
+    bool _isKeepAlive; // 本批最后一个请求是否keep-alive
+    // 登录/注册的异步校验：WAITING期间连接不监听任何事件，执行器线程把结果写进来后重新注册EPOLLOUT
+    enum AUTH_STATE : uint8_t
+    {
+        AUTH_IDLE,
+        AUTH_WAITING,
+        AUTH_FAILED,
+        AUTH_OK,
+    };
+    std::atomic<uint8_t> _auth;
+    std::mutex _mtx;
+
+    size_t _iovIdx;
+    size_t _iovBytes;
+
+    // 下一个要发的文件区间，_sendLen为各区间剩余的字节数之和
+    size_t _sliceIdx;
+    size_t _sendLen;
+
+    ChainBuffer _writeBuff;
+    Context *_ctx;
 
-    int _iovCnt;
-    struct iovec _iov[2];
+    static thread_local std::vector<std::unique_ptr<Context>> _freeContexts;
 
-    Buffer _readBuff;
-    Buffer _writeBuff;
+    static Context *AcquireContext_();
+    static void ReleaseContext_(Context *ctx);
+    void DetachContext_();
 
-    HttpRequest _request;
-    HttpResponse _response;
+    HttpResponse &NextResponse_();
+    void ReleaseResponses_();
+    void AddIov_(const void *base, size_t len);
+    void AddSlice_(int fd, off_t off, size_t len);
 
 public:
     HttpConn();
@@ -38,15 +89,36 @@ public:
     ssize_t Write(int *saveErrno);
     void Close();
     int GetFd() const;
+    uint32_t Generation() const;
+    // 处理事件、关闭连接以及从别的线程改动连接状态时都要持有，保证Context不会在使用中被另一个线程释放
+    std::mutex &Mutex();
     int GetPort() const;
     const char *GetIP() const;
     sockaddr_in GetAddr() const;
     bool process();
 
-    int ToWriteBytes() const;
+    // process()返回false且WaitingAuth()时，调用者应把AuthQuery()交给SQL执行器，完成后调用FinishAuth
+    bool WaitingAuth() const;
+    void AuthQuery(std::string &name, std::string &pwd, bool &isLogin) const;
+    // 可在任意线程调用；连接已不在等待(已关闭或复用)时返回false
+    bool FinishAuth(bool ok);
+
+    size_t ToWriteBytes() const;
     bool IsKeepAlive() const;
 
+    static const size_t MAX_PIPELINE = 16; // 一次process最多处理的流水线请求数
+    static const size_t MAX_FREE_CONTEXT = 64; // 每个线程缓存的空闲Context数
+
+    // 单个连接空闲时与处理请求时各自占用的字节数，用于回归内存占用。
+    // 只算对象本身：不含ConnSlab按块预分配而未使用的槽位，
+    // 也不含各线程缓存的空闲Context(每线程最多MAX_FREE_CONTEXT个)和ChainBuffer空闲块(每线程最多256个)
+    static size_t IdleBytes();
+    static size_t ActiveBytes();
+
     static bool isET;
+    // 一次Write最多写出的字节数，写满后让出线程、等下一次EPOLLOUT再继续，0为不限。
+    // 大文件下载不会长时间占住工作线程，排在后面的小请求不必等它写到EAGAIN
+    static size_t writeQuantum;
     static const char *srcDir;
     static std::atomic<int> userCount;
 };
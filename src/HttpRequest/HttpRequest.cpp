@@ -1,174 +1,289 @@
 #include "HttpRequest.hpp"
 
+std::string_view HttpRequest::TrimOWS(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+static bool EqualsNoCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
 HttpRequest::HttpRequest() { Init(); }
 
+// clear()保留字符串容量，连接复用时解析请求不再分配内存
 void HttpRequest::Init()
 {
-    _method = _path = _version = _body = "";
+    _method.clear();
+    _path.clear();
+    _version.clear();
+    _body.clear();
     _state = REQUEST_LINE;
-    _header.clear();
+    _base = nullptr;
+    _parsed = 0;
+    _contentLength = 0;
+    _isKeepAlive = false;
+    _authTag = -1;
+    _headerCnt = 0;
     _post.clear();
 }
 
 const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML = {"/index", "/register", "/login", "/welcome", "/video", "/picture"};
 const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG = {{"/register.html", 0}, {"/login.html", 1}, {"/welcome.html", 2}};
-const std::regex HttpRequest::request_line_pattern(R"(^([^ ]*) ([^ ]*) HTTP/([^ ]*)$)", std::regex::optimize);
-const std::regex HttpRequest::header_pattern(R"(^([^:]*): ?(.*)$)", std::regex::optimize);
-
-// bool HttpRequest::IsKeepAlive() const
-// {
-//     if (_header.count("Connection") == 1)
-//     {
-//         return _header.find("Connection")->second == "keep-alive" && _version == "1.1";
-//     }
-//     return false;
-// }
 
 bool HttpRequest::IsKeepAlive() const
 {
-    auto it = _header.find("Connection");
-    return it != _header.end() && it->second == "keep-alive" && _version == "1.1";
+    return _isKeepAlive;
+}
+
+bool HttpRequest::AcceptsEncoding(std::string_view coding) const
+{
+    std::string_view value = GetHeader("Accept-Encoding");
+    bool wildcard = false;
+    while (!value.empty())
+    {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view name = TrimOWS(item.substr(0, semi));
+        // q=0、q=0.0、q=0.000都表示不接受
+        bool refused = false;
+        if (semi != std::string_view::npos)
+        {
+            std::string_view params = item.substr(semi + 1);
+            size_t q = params.find("q=");
+            if (q != std::string_view::npos)
+            {
+                std::string_view qv = params.substr(q + 2);
+                refused = !qv.empty() && qv[0] == '0';
+                for (size_t i = 1; refused && i < qv.size() && qv[i] != ' ' && qv[i] != ';'; ++i)
+                {
+                    refused = qv[i] == '.' || qv[i] == '0';
+                }
+            }
+        }
+        if (EqualsNoCase(name, coding))
+        {
+            return !refused;
+        }
+        if (name == "*")
+        {
+            wildcard = !refused;
+        }
+    }
+    return wildcard;
+}
+
+bool HttpRequest::NeedsAuth() const
+{
+    return _authTag >= 0;
+}
+
+bool HttpRequest::IsLogin() const
+{
+    return _authTag == 1;
+}
+
+void HttpRequest::SetAuthResult(bool ok)
+{
+    _authTag = -1;
+    _path = ok ? "/welcome.html" : "/error.html";
+}
+
+size_t HttpRequest::Consumed() const
+{
+    return _parsed;
 }
 
-bool HttpRequest::parse(Buffer &buff)
+// 逐行推进的状态机，直接在读缓冲上切string_view，不做逐行拷贝。
+// 请求不完整时返回NO_REQUEST并保留进度，调用者在请求完整之前不能Retrieve读缓冲；
+// 完整请求只消费Consumed()字节，之后的流水线请求留在缓冲中，Init()后继续parse。
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer &buff)
 {
-    const char CRLF[] = "\r\n";
     if (buff.ReadableBytes() <= 0)
     {
-        return false;
+        return NO_REQUEST;
     }
 
-    while (buff.ReadableBytes() && _state != FINISH)
+    std::string_view data = buff.PeekView();
+    _base = data.data();
+    const char *end = data.data() + data.size();
+    while (_state != FINISH)
     {
-        const char *begin = buff.Peek();
-        const char *end = buff.BeginWriteConst();
-        const char *lineEnd = std::search(begin, end, CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
+        const char *begin = _base + _parsed;
+        if (_state == BODY)
+        {
+            size_t received = end - begin;
+            if (received < _contentLength)
+            {
+                // 按Content-Length一次留够空间，之后readv直接读进来，正文不会随扩容被反复拷贝
+                buff.EnsureWriteable(_contentLength - received);
+                return NO_REQUEST;
+            }
+            _parsed += _contentLength;
+            _ParseBody(std::string_view(begin, _contentLength));
+            break;
+        }
+        const char *lineEnd = buff.FindCRLF(begin);
+        if (!lineEnd)
+        {
+            if (static_cast<size_t>(end - _base) > MAX_HEADER_SIZE)
+            {
+                LOG_WARN("Request header too large");
+                return BAD_REQUEST;
+            }
+            return NO_REQUEST;
+        }
+        std::string_view line(begin, lineEnd - begin);
+        _parsed = lineEnd + 2 - _base;
         switch (_state)
         {
         case REQUEST_LINE:
             if (!_ParseRequestLine(line))
             {
-                return false;
+                return BAD_REQUEST;
             }
             _ParsePath();
             break;
         case HEADERS:
-            _ParseHeader(line);
-            if (buff.ReadableBytes() <= 2)
+            if (!_ParseHeader(line))
+            {
+                return BAD_REQUEST;
+            }
+            if (_state == HEADERS)
             {
+                break;
+            }
+            // 空行：头部结束，有Content-Length才有正文
+            if (_contentLength == 0)
+            {
+                _ParsePost();
                 _state = FINISH;
             }
             break;
-        case BODY:
-            _ParseBody(line);
-            break;
         default:
             break;
         }
-        if (lineEnd == buff.BeginWrite())
-        {
-            break;
-        }
-        buff.RetrieveUntil(lineEnd + 2);
     }
     LOG_DEBUG("[%s], [%s], [%s]", _method.c_str(), _path.c_str(), _version.c_str());
-    return true;
+    return GET_REQUEST;
 }
 
-bool HttpRequest::_ParseRequestLine(const std::string &line)
+// METHOD SP request-target SP HTTP/version
+bool HttpRequest::_ParseRequestLine(std::string_view line)
 {
-    std::smatch subMatch;
-
-    if (regex_match(line, subMatch, request_line_pattern))
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1)
     {
-        _method = subMatch[1];
-        _path = subMatch[2];
-        _version = subMatch[3];
-        _state = HEADERS;
-        return true;
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    std::string_view proto = line.substr(sp2 + 1);
+    if (proto.size() <= 5 || proto.compare(0, 5, "HTTP/") != 0 || proto.find(' ') != std::string_view::npos)
+    {
+        LOG_ERROR("RequestLine Error");
+        return false;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    _method.assign(line.data(), sp1);
+    _path.assign(line.data() + sp1 + 1, sp2 - sp1 - 1);
+    _version.assign(proto.data() + 5, proto.size() - 5);
+    _state = HEADERS;
+    return true;
 }
 
-// bool HttpRequest::_ParseRequestLine(std::string_view line)
-// {
-//     std::cmatch subMatch;
-
-//     if (std::regex_match(line.begin(), line.end(), subMatch, request_line_pattern))
-//     {
-//         _method = subMatch[1].str();
-//         _path = subMatch[2].str();
-//         _version = subMatch[3].str();
-//         _state = HEADERS;
-//         return true;
-//     }
-//     LOG_ERROR("RequestLine Error");
-//     return false;
-// }
-
 void HttpRequest::_ParsePath()
 {
     if (_path == "/")
     {
         _path = "/index.html";
     }
-    else
+    else if (DEFAULT_HTML.count(_path))
     {
-        for (auto &item : DEFAULT_HTML)
-        {
-            if (item == _path)
-            {
-                _path += ".html";
-                break;
-            }
-        }
+        _path += ".html";
     }
 }
 
-void HttpRequest::_ParseHeader(const std::string &line)
+// field-name ":" OWS field-value OWS，空行表示头部结束
+bool HttpRequest::_ParseHeader(std::string_view line)
 {
-    std::smatch subMatch;
-    if (regex_match(line, subMatch, header_pattern))
+    if (line.empty())
+    {
+        _state = BODY;
+        return true;
+    }
+    const char *colon = static_cast<const char *>(memchr(line.data(), ':', line.size()));
+    if (!colon || colon == line.data())
     {
-        _header[subMatch[1]] = subMatch[2];
+        LOG_ERROR("Header Error");
+        return false;
     }
-    else
+    std::string_view name(line.data(), colon - line.data());
+    std::string_view value = TrimOWS(line.substr(name.size() + 1));
+
+    // 头部总长已由MAX_HEADER_SIZE限制，表满之后的字段不再记录(GetHeader查不到)，但下面的字段照常处理
+    if (_headerCnt < MAX_HEADERS)
     {
-        _state = BODY;
+        HeaderField &field = _header[_headerCnt++];
+        field.nameOff = name.data() - _base;
+        field.nameLen = name.size();
+        field.valueOff = value.data() - _base;
+        field.valueLen = value.size();
+    }
+
+    if (EqualsNoCase(name, "Connection"))
+    {
+        _isKeepAlive = EqualsNoCase(value, "keep-alive") && _version == "1.1";
+    }
+    else if (EqualsNoCase(name, "Content-Length"))
+    {
+        size_t len = 0;
+        if (value.empty() || value.size() > 9)
+        {
+            return false;
+        }
+        for (char ch : value)
+        {
+            if (ch < '0' || ch > '9')
+            {
+                return false;
+            }
+            len = len * 10 + (ch - '0');
+        }
+        if (len > MAX_BODY_SIZE)
+        {
+            LOG_WARN("Request body too large: %zu", len);
+            return false;
+        }
+        _contentLength = len;
+    }
+    else if (EqualsNoCase(name, "Transfer-Encoding"))
+    {
+        // 不支持chunked请求体，无法确定请求边界，不能再继续解析流水线
+        return false;
     }
+    return true;
 }
 
-// void HttpRequest::_ParseHeader(std::string_view line)
-// {
-//     std::cmatch subMatch;
-//     if (std::regex_match(line.begin(), line.end(), subMatch, header_pattern))
-//     {
-//         _header[subMatch[1].str()] = subMatch[2].str();
-//     }
-//     else
-//     {
-//         _state = BODY;
-//     }
-// }
-
-void HttpRequest::_ParseBody(const std::string &line)
+void HttpRequest::_ParseBody(std::string_view body)
 {
-    _body = line;
+    _body.assign(body.data(), body.size());
     _ParsePost();
     _state = FINISH;
-    LOG_DEBUG("Body: %s, len: %d", line.c_str(), line.size());
+    LOG_DEBUG("Body: %s, len: %d", _body.c_str(), _body.size());
 }
 
-// void HttpRequest::_ParseBody(std::string_view line)
-// {
-//     _body = line;
-//     _ParsePost();
-//     _state = FINISH;
-//     LOG_DEBUG("Body: %s, len: %d", line.data(), line.size());
-// }
-
 int HttpRequest::ConverHex(char ch)
 {
     if (ch >= 'A' && ch <= 'F')
@@ -184,7 +299,7 @@ int HttpRequest::ConverHex(char ch)
 
 void HttpRequest::_ParsePost()
 {
-    if (_method == "POST" && _header["Content-Type"] == "application/x-www-form-urlencoded")
+    if (_method == "POST" && GetHeader("Content-Type") == "application/x-www-form-urlencoded")
     {
         _ParseFromUrlencoded();
         if (DEFAULT_HTML_TAG.count(_path))
@@ -193,15 +308,7 @@ void HttpRequest::_ParsePost()
             LOG_DEBUG("Tag:%d", tag);
             if (tag == 0 || tag == 1)
             {
-                bool isLogin = (tag == 1);
-                if (UserVerify(_post["username"], _post["password"], isLogin))
-                {
-                    _path = "/welcome.html";
-                }
-                else
-                {
-                    _path = "/error.html";
-                }
+                _authTag = tag;
             }
         }
     }
@@ -254,92 +361,6 @@ void HttpRequest::_ParseFromUrlencoded()
     }
 }
 
-bool HttpRequest::UserVerify(const std::string &name, const std::string &pwd, bool isLogin)
-{
-    if (name.empty() || pwd.empty())
-        return false;
-
-    LOG_INFO("Verify name:%s, pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL *sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
-
-    bool flag = false;
-    // unsigned int j = 0;
-    char order[256] = {0};
-    // MYSQL_FIELD *fields = nullptr;
-    MYSQL_RES *res = nullptr;
-
-    if (!isLogin)
-        flag = true;
-
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-
-    if (mysql_query(sql, order))
-    {
-        if (res)
-            mysql_free_result(res);
-        return false;
-    }
-
-    res = mysql_store_result(sql);
-    if (!res)
-    {
-        LOG_ERROR("mysql_store_result error!");
-        return false;
-    }
-
-    mysql_num_fields(res);
-    mysql_fetch_fields(res);
-    // j = mysql_num_fields(res);
-    // fields = mysql_fetch_fields(res);
-
-    while (MYSQL_ROW row = mysql_fetch_row(res))
-    {
-        LOG_DEBUG("MYSQL ROW: %s, %s", row[0], row[1]);
-        std::string password(row[1]);
-        if (isLogin)
-        {
-            if (pwd == password)
-            {
-                flag = true;
-            }
-            else
-            {
-                flag = false;
-                LOG_INFO("pwd error!");
-            }
-        }
-        else
-        {
-            flag = false;
-            LOG_INFO("user used!");
-        }
-    }
-    mysql_free_result(res);
-
-    if (!isLogin && flag)
-    {
-        LOG_DEBUG("register!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s', '%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);
-        if (mysql_query(sql, order))
-        {
-            LOG_DEBUG("Insert Error!");
-            flag = false;
-        }
-        else
-        {
-            flag = true;
-        }
-    }
-
-    LOG_DEBUG("UserVerify Success!");
-    return flag;
-}
-
 std::string HttpRequest::path() const
 {
     return _path;
@@ -373,3 +394,16 @@ std::string HttpRequest::GetPost(const char *key) const
     auto it = _post.find(key);
     return it != _post.end() ? it->second : "";
 }
+
+std::string_view HttpRequest::GetHeader(std::string_view key) const
+{
+    for (int i = 0; i < _headerCnt; ++i)
+    {
+        const HeaderField &field = _header[i];
+        if (EqualsNoCase(std::string_view(_base + field.nameOff, field.nameLen), key))
+        {
+            return std::string_view(_base + field.valueOff, field.valueLen);
+        }
+    }
+    return std::string_view();
+}
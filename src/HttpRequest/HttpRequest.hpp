@@ -4,29 +4,24 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <strings.h>
 #include <error.h>
-#include <mysql/mysql.h>
 
 #include "../Buffer/Buffer.hpp"
 #include "../Log/Log.hpp"
-#include "../SQL/SQLconnPool.hpp"
 
 class HttpRequest
 {
 private:
-    // bool _ParseRequestLine(std::string_view line);
-    // void _ParseHeader(std::string_view line);
-    // void _ParseBody(std::string_view line);
-    bool _ParseRequestLine(const std::string& lin);
-    void _ParseHeader(const std::string& lin);
-    void _ParseBody(const std::string& lin);
+    bool _ParseRequestLine(std::string_view line);
+    bool _ParseHeader(std::string_view line);
+    void _ParseBody(std::string_view body);
 
     void _ParsePath();
     void _ParsePost();
     void _ParseFromUrlencoded();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
     static int ConverHex(char ch);
 
 private:
@@ -37,32 +32,65 @@ private:
         BODY,
         FINISH,
     };
-    
+
+    // 头部字段不拷贝，只记录相对请求起始(_base)的偏移，读缓冲扩容搬移后依然有效
+    struct HeaderField
+    {
+        uint32_t nameOff, nameLen;
+        uint32_t valueOff, valueLen;
+    };
+    static const int MAX_HEADERS = 32;            // 记录的头部字段数，多出的忽略
+    static const size_t MAX_HEADER_SIZE = 8192;   // 请求行+头部的上限，超过仍不完整则视为错误
+    static const size_t MAX_BODY_SIZE = 1 << 20;  // Content-Length上限
+
     PARSE_STATE _state;
     std::string _method, _path, _version, _body;
-    std::unordered_map<std::string, std::string> _header;
+    const char *_base;   // 当前请求在读缓冲中的起始位置，每次parse时刷新
+    size_t _parsed;      // 已解析的字节数，跨多次parse调用保留
+    size_t _contentLength;
+    bool _isKeepAlive;
+    int _authTag;    // 需要查库的表单：-1无，0注册，1登录；结果由SetAuthResult填回
+    int _headerCnt;
+    HeaderField _header[MAX_HEADERS];
     std::unordered_map<std::string, std::string> _post;
-    
-    static const std::regex request_line_pattern;
-    static const std::regex header_pattern;
+
     static const std::unordered_set<std::string> DEFAULT_HTML;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
-    
+
 public:
+    enum HTTP_CODE
+    {
+        NO_REQUEST,  // 请求还不完整，保留解析进度等待更多数据
+        GET_REQUEST, // 解析出一个完整请求，读缓冲中可能还跟着下一个请求
+        BAD_REQUEST,
+    };
+
     HttpRequest();
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer &buff);
-    
+    HTTP_CODE parse(Buffer &buff);
+    size_t Consumed() const;
+
     std::string path() const;
     std::string &path();
     std::string method() const;
     std::string version() const;
     std::string GetPost(const std::string &key) const;
     std::string GetPost(const char *key) const;
+    // 返回的视图指向读缓冲，只在该请求的字节被Retrieve之前有效
+    std::string_view GetHeader(std::string_view key) const;
 
     bool IsKeepAlive() const;
+    // Accept-Encoding是否接受coding(如"gzip")：列出且q不为0，或*且未单独排除
+    bool AcceptsEncoding(std::string_view coding) const;
+    // 去掉首尾的空格和制表符(RFC 7230的OWS)，解析头部字段值和逗号分隔的列表时用
+    static std::string_view TrimOWS(std::string_view s);
+
+    // 登录/注册请求解析完后不在解析器里查库，由调用者异步校验后调用SetAuthResult
+    bool NeedsAuth() const;
+    bool IsLogin() const;
+    void SetAuthResult(bool ok);
 };
 
-#endif // HTTPREQUEST_HPP
\ No newline at end of file
+#endif // HTTPREQUEST_HPP
@@ -1,32 +1,36 @@
 #include "HttpResponse.hpp"
 
-const std::unordered_map<std::string, std::string> HttpResponse::_SUFFIX_TYPE = {
-    {".html", "text/html"},
-    {".xml", "text/xml"},
-    {".xhtml", "application/xhtml+xml"},
-    {".txt", "text/plain"},
-    {".rtf", "application/rtf"},
-    {".pdf", "application/pdf"},
-    {".word", "application/nsword"},
-    {".png", "image/png"},
-    {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},
-    {".jpeg", "image/jpeg"},
-    {".au", "audio/basic"},
-    {".mpeg", "video/mpeg"},
-    {".mpg", "video/mpeg"},
-    {".avi", "video/x-msvideo"},
-    {".gz", "application/x-gzip"},
-    {".tar", "application/x-tar"},
-    {".css", "text/css "},
-    {".js", "text/javascript "},
+// 页面每次都回源校验(命中时只回304)；样式脚本缓存一天；图片、音视频等基本不改的资源缓存一周
+const std::unordered_map<std::string, HttpResponse::FileType> HttpResponse::_SUFFIX_TYPE = {
+    {".html", {"text/html", "no-cache"}},
+    {".xml", {"text/xml", "no-cache"}},
+    {".xhtml", {"application/xhtml+xml", "no-cache"}},
+    {".txt", {"text/plain", "no-cache"}},
+    {".rtf", {"application/rtf", "public, max-age=86400"}},
+    {".pdf", {"application/pdf", "public, max-age=86400"}},
+    {".word", {"application/nsword", "public, max-age=86400"}},
+    {".png", {"image/png", "public, max-age=604800"}},
+    {".gif", {"image/gif", "public, max-age=604800"}},
+    {".jpg", {"image/jpeg", "public, max-age=604800"}},
+    {".jpeg", {"image/jpeg", "public, max-age=604800"}},
+    {".au", {"audio/basic", "public, max-age=604800"}},
+    {".mpeg", {"video/mpeg", "public, max-age=604800"}},
+    {".mpg", {"video/mpeg", "public, max-age=604800"}},
+    {".avi", {"video/x-msvideo", "public, max-age=604800"}},
+    {".gz", {"application/x-gzip", "public, max-age=86400"}},
+    {".tar", {"application/x-tar", "public, max-age=86400"}},
+    {".css", {"text/css ", "public, max-age=86400"}},
+    {".js", {"text/javascript ", "public, max-age=86400"}},
 };
 
 const std::unordered_map<int, std::string> HttpResponse::_CODE_STATUS = {
     {200, "OK"},
+    {206, "Partial Content"},
+    {304, "Not Modified"},
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {416, "Range Not Satisfiable"},
 };
 
 const std::unordered_map<int, std::string> HttpResponse::_CODE_PATH = {
@@ -35,31 +39,59 @@ const std::unordered_map<int, std::string> HttpResponse::_CODE_PATH = {
     {404, "/404.html"},
 };
 
-HttpResponse::HttpResponse() : _code(-1), _isKeepAlive(false), _path(""), _srcDir(""), _mmFile(nullptr), _mmFileStat({0}){};
+const std::unordered_set<std::string> HttpResponse::_COMPRESSIBLE = {
+    ".html", ".xml", ".xhtml", ".txt", ".rtf", ".css", ".js",
+};
+
+size_t HttpResponse::sendfileThreshold = 64 * 1024;
+
+HttpResponse::HttpResponse() : _code(-1), _isKeepAlive(false), _gzip(false), _lastModified(0), _path(""), _srcDir(""), _mmFile(nullptr), _fileFd(-1), _mmFileStat({0}){};
 
 HttpResponse::~HttpResponse()
 {
     UnmapFile();
 }
 
-void HttpResponse::Init(const std::string &srcDir, std::string &path, bool isKeepAlive, int code)
+void HttpResponse::Init(const std::string &srcDir, std::string &path, bool isKeepAlive, int code, const Negotiation &neg)
 {
     assert(srcDir != "");
-    if (_mmFile)
-    {
-        UnmapFile();
-    }
+    UnmapFile();
     _code = code;
     _isKeepAlive = isKeepAlive;
+    _neg = neg;
+    if (!_neg.range.empty())
+    {
+        // 区间只在原始内容上切，带Range的请求不走gzip
+        _neg.acceptGzip = false;
+    }
+    _gzip = false;
+    _etag.clear();
+    _ranges.clear();
+    _parts.clear();
+    _boundary.clear();
     _path = path;
     _srcDir = srcDir;
     // _mmFile = nullptr;
     // _mmFileStat = {0};
 }
 
-void HttpResponse::MakeResponse(Buffer &buff)
+void HttpResponse::MakeResponse(ChainBuffer &buff)
 {
-    if (stat((_srcDir + _path).c_str(), &_mmFileStat) < 0 || S_ISDIR(_mmFileStat.st_mode))
+    if (_code == 200)
+    {
+        // 命中缓存：响应头已序列化好，正文在内存里，不需要stat/open/mmap
+        _cached = FileCache::Instance()->Get(_srcDir + _path);
+        if (_cached)
+        {
+            SendCached_(buff);
+            return;
+        }
+    }
+    if (_code == 400)
+    {
+        ErrorHtml();
+    }
+    else if (stat((_srcDir + _path).c_str(), &_mmFileStat) < 0 || S_ISDIR(_mmFileStat.st_mode))
     {
         _code = 404;
         ErrorHtml();
@@ -73,16 +105,71 @@ void HttpResponse::MakeResponse(Buffer &buff)
     {
         _code = 200;
     }
+    if (_code == 200)
+    {
+        // 首次访问：载入缓存(同时生成gzip版本)后和命中时一样发送；进不了缓存的文件看有没有预压缩的.gz
+        if (LoadCached_())
+        {
+            SendCached_(buff);
+            return;
+        }
+        // 校验头按原文件生成，UseGzipSibling_会把_mmFileStat换成.gz的
+        struct timespec mtime = _mmFileStat.st_mtim;
+        off_t size = _mmFileStat.st_size;
+        if (_neg.acceptGzip && Compressible_())
+        {
+            UseGzipSibling_();
+        }
+        SetValidators_(mtime, size);
+        if (NotModified_())
+        {
+            AddNotModified_(buff);
+            return;
+        }
+        SelectRanges_(_mmFileStat.st_size);
+        if (_code == 416)
+        {
+            AddStateLine_(buff);
+            AddHeader_(buff);
+            AddLength_(buff, _mmFileStat.st_size);
+            return;
+        }
+    }
     AddStateLine_(buff);
     AddHeader_(buff);
     AddContent_(buff);
 }
 
+void HttpResponse::MakeContent(ChainBuffer &buff, const std::string &body, const char *type)
+{
+    assert(type);
+    _code = 200;
+    _mmFileStat.st_size = 0;
+    AddStateLine_(buff);
+    AddHeader_(buff, type);
+    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
+}
+
 char *HttpResponse::File()
 {
+    return const_cast<char *>(Body_());
+}
+
+const char *HttpResponse::Body_() const
+{
+    if (_cached)
+    {
+        return _gzip ? _cached->gzBody.data() : _cached->body.data();
+    }
     return _mmFile;
 }
 
+int HttpResponse::FileFd() const
+{
+    return _fileFd;
+}
+
 // std::unique_ptr<char[]> HttpResponse::File()
 // {
 //     return std::move(_mmFile);
@@ -90,6 +177,14 @@ char *HttpResponse::File()
 
 size_t HttpResponse::FileLen() const
 {
+    if (_code == 304 || _code == 416)
+    {
+        return 0;
+    }
+    if (_cached)
+    {
+        return _gzip ? _cached->gzBody.size() : _cached->size;
+    }
     return _mmFileStat.st_size;
 }
 
@@ -114,7 +209,7 @@ void HttpResponse::ErrorHtml()
     }
 }
 
-// void HttpResponse::AddStateLine_(Buffer &buff)
+// void HttpResponse::AddStateLine_(ChainBuffer &buff)
 // {
 //     std::string status;
 //     if (_CODE_STATUS.count(_code) == 1)
@@ -129,7 +224,7 @@ void HttpResponse::ErrorHtml()
 //     buff.Append("HTTP/1.1 " + std::to_string(_code) + " " + status + "\r\n");
 // }
 
-void HttpResponse::AddStateLine_(Buffer &buff)
+void HttpResponse::AddStateLine_(ChainBuffer &buff)
 {
     auto it = _CODE_STATUS.find(_code);
     if (it != _CODE_STATUS.end())
@@ -144,8 +239,12 @@ void HttpResponse::AddStateLine_(Buffer &buff)
     }
 }
 
-void HttpResponse::AddHeader_(Buffer &buff)
+void HttpResponse::AddHeader_(ChainBuffer &buff, const char *type)
 {
+    std::string_view date = TimeCache::HttpDate();
+    buff.Append("Date: ", 6);
+    buff.Append(date.data(), date.size());
+    buff.Append("\r\n", 2);
     buff.Append("Connection: ");
     if (_isKeepAlive)
     {
@@ -156,7 +255,40 @@ void HttpResponse::AddHeader_(Buffer &buff)
     {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType() + "\r\n");
+    if (_code == 206 && _ranges.size() > 1)
+    {
+        buff.Append("Content-type: multipart/byteranges; boundary=" + _boundary + "\r\n");
+    }
+    else if (_code != 304 && _code != 416)
+    {
+        buff.Append("Content-type: " + (type ? std::string(type) : GetFileType()) + "\r\n");
+    }
+    if (!_etag.empty())
+    {
+        char lastModified[TimeCache::HTTP_DATE_LEN + 1];
+        TimeCache::FormatHttpDate(_lastModified, lastModified);
+        buff.Append("ETag: " + _etag + "\r\n");
+        buff.Append("Last-Modified: ", 15);
+        buff.Append(lastModified, TimeCache::HTTP_DATE_LEN);
+        buff.Append("\r\n", 2);
+        if (!CacheControl_().empty())
+        {
+            buff.Append("Cache-Control: " + CacheControl_() + "\r\n");
+        }
+        if (!_gzip)
+        {
+            buff.Append("Accept-Ranges: bytes\r\n");
+        }
+    }
+    if ((_code == 200 || _code == 206 || _code == 304) && Compressible_())
+    {
+        // 同一URL按Accept-Encoding返回不同正文，告诉中间缓存
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    if (_gzip)
+    {
+        buff.Append("Content-Encoding: gzip\r\n");
+    }
 }
 
 // std::unique_ptr<char[]> HttpResponse::MapFile(const std::string &filePath, size_t &fileSize, Buffer &buff)
@@ -186,9 +318,9 @@ void HttpResponse::AddHeader_(Buffer &buff)
 //     return mmFile;
 // }
 
-void HttpResponse::AddContent_(Buffer &buff)
+void HttpResponse::AddContent_(ChainBuffer &buff)
 {
-    int srcFd = open((_srcDir + _path).data(), O_RDONLY);
+    int srcFd = open((_srcDir + _path + (_gzip ? ".gz" : "")).data(), O_RDONLY);
     if (srcFd < 0)
     {
         ErrorContent(buff, "File NotFound!");
@@ -196,18 +328,29 @@ void HttpResponse::AddContent_(Buffer &buff)
     }
 
     LOG_DEBUG("file path %s", (_srcDir + _path).data());
-    int *mmRet = (int *)mmap(0, _mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1)
+    if (static_cast<size_t>(_mmFileStat.st_size) >= sendfileThreshold)
     {
-        ErrorContent(buff, "File NotFound!");
+        // 大文件不做映射，保留fd交给HttpConn::Write用sendfile分段发送，避免每个请求mmap/munmap的TLB开销
+        _fileFd = srcFd;
+        AddLength_(buff, _mmFileStat.st_size);
         return;
     }
-    _mmFile = (char *)mmRet;
+    if (_mmFileStat.st_size > 0)
+    {
+        void *mmRet = mmap(0, _mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        if (mmRet == MAP_FAILED)
+        {
+            close(srcFd);
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+        _mmFile = (char *)mmRet;
+    }
     close(srcFd);
-    buff.Append("Content-length: " + std::to_string(_mmFileStat.st_size) + "\r\n\r\n");
+    AddLength_(buff, _mmFileStat.st_size);
 }
 
-// void HttpResponse::AddContent_(Buffer &buff)
+// void HttpResponse::AddContent_(ChainBuffer &buff)
 // {
 //     try
 //     {
@@ -221,13 +364,328 @@ void HttpResponse::AddContent_(Buffer &buff)
 //     }
 // }
 
+// 只缓存200的普通文件，其余状态码的响应每次现做
+bool HttpResponse::LoadCached_()
+{
+    FileCache *cache = FileCache::Instance();
+    if (!cache->IsOpen() || !S_ISREG(_mmFileStat.st_mode) || static_cast<size_t>(_mmFileStat.st_size) > cache->MaxFileSize())
+    {
+        return false;
+    }
+    int fd = open((_srcDir + _path).data(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    _cached = cache->Load(_srcDir + _path, fd, _mmFileStat,
+                          [this](bool isKeepAlive, bool gzip, size_t len)
+                          { return CachedHeader_(isKeepAlive, gzip, len); },
+                          Compressible_());
+    close(fd);
+    return _cached != nullptr;
+}
+
+// 缓存里的文件：条件请求命中时回304并释放条目，否则发缓存的响应头
+void HttpResponse::SendCached_(ChainBuffer &buff)
+{
+    _code = 200;
+    _gzip = _neg.acceptGzip && !_cached->gzBody.empty();
+    SetValidators_(_cached->mtime, _cached->size);
+    if (NotModified_())
+    {
+        _cached.reset();
+        AddNotModified_(buff);
+        return;
+    }
+    size_t size = FileLen();
+    SelectRanges_(size);
+    if (_code == 200)
+    {
+        AddCachedHeader_(buff);
+        return;
+    }
+    // 206/416的响应头随区间而变，不缓存
+    if (_code == 416)
+    {
+        _cached.reset();
+    }
+    AddStateLine_(buff);
+    AddHeader_(buff);
+    AddLength_(buff, size);
+}
+
+// 按keep-alive和Accept-Encoding选出缓存的响应头，缓存的响应头里是生成时的Date，拼接时换成当前时间
+void HttpResponse::AddCachedHeader_(ChainBuffer &buff)
+{
+    const std::string &header = _gzip ? _cached->gzHeader[_isKeepAlive] : _cached->header[_isKeepAlive];
+    size_t pos = header.find("Date: ");
+    if (pos == std::string::npos)
+    {
+        buff.Append(header);
+        return;
+    }
+    std::string_view date = TimeCache::HttpDate();
+    pos += 6;
+    buff.Append(header.data(), pos);
+    buff.Append(date.data(), date.size());
+    buff.Append(header.data() + pos + date.size(), header.size() - pos - date.size());
+}
+
+// 生成缓存条目里的完整响应头，与AddStateLine_/AddHeader_/AddContent_的输出一致
+std::string HttpResponse::CachedHeader_(bool isKeepAlive, bool gzip, size_t len)
+{
+    ChainBuffer header;
+    bool keepAlive = _isKeepAlive;
+    bool useGzip = _gzip;
+    _isKeepAlive = isKeepAlive;
+    _gzip = gzip;
+    SetValidators_(_mmFileStat.st_mtim, _mmFileStat.st_size);
+    AddStateLine_(header);
+    AddHeader_(header);
+    _isKeepAlive = keepAlive;
+    _gzip = useGzip;
+    header.Append("Content-length: " + std::to_string(len) + "\r\n\r\n");
+    return header.RetrieveAllToStr();
+}
+
+bool HttpResponse::Compressible_() const
+{
+    size_t idx = _path.find_last_of('.');
+    return idx != std::string::npos && _COMPRESSIBLE.count(_path.substr(idx));
+}
+
+// 进不了文件缓存的大文件：部署时预先压缩好的同名.gz(不比原文件旧)直接作为正文发送
+void HttpResponse::UseGzipSibling_()
+{
+    struct stat gz;
+    if (stat((_srcDir + _path + ".gz").c_str(), &gz) == 0 && S_ISREG(gz.st_mode) && (gz.st_mode & S_IROTH) &&
+        gz.st_mtime >= _mmFileStat.st_mtime)
+    {
+        _gzip = true;
+        _mmFileStat = gz;
+    }
+}
+
+// 强校验器：mtime(纳秒)和大小变了就换，gzip版本的正文不同，ETag也要不同
+void HttpResponse::SetValidators_(const struct timespec &mtime, off_t size)
+{
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%lx.%lx-%lx%s\"", static_cast<unsigned long>(mtime.tv_sec),
+             static_cast<unsigned long>(mtime.tv_nsec), static_cast<unsigned long>(size), _gzip ? "-gz" : "");
+    _etag = etag;
+    _lastModified = mtime.tv_sec;
+}
+
+// RFC 7232：有If-None-Match时只看它(弱比较，忽略W/前缀)，否则看If-Modified-Since
+bool HttpResponse::NotModified_() const
+{
+    if (!_neg.ifNoneMatch.empty())
+    {
+        std::string_view list = _neg.ifNoneMatch;
+        while (!list.empty())
+        {
+            size_t comma = list.find(',');
+            std::string_view tag = HttpRequest::TrimOWS(list.substr(0, comma));
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            if (tag.substr(0, 2) == "W/")
+            {
+                tag.remove_prefix(2);
+            }
+            if (tag == "*" || tag == _etag)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    time_t since;
+    return !_neg.ifModifiedSince.empty() && TimeCache::ParseHttpDate(_neg.ifModifiedSince, since) &&
+           _lastModified <= since;
+}
+
+// 304只有状态行和响应头，不带正文也不带Content-length
+void HttpResponse::AddNotModified_(ChainBuffer &buff)
+{
+    _code = 304;
+    _mmFileStat.st_size = 0;
+    AddStateLine_(buff);
+    AddHeader_(buff);
+    buff.Append("\r\n", 2);
+}
+
+// If-Range只做强比较：ETag必须完全相同，日期必须正好是Last-Modified，不匹配就发整个文件
+bool HttpResponse::IfRangeMatches_() const
+{
+    std::string_view cond = _neg.ifRange;
+    if (cond.empty())
+    {
+        return true;
+    }
+    if (cond.front() == '"')
+    {
+        return cond == _etag;
+    }
+    time_t date;
+    return TimeCache::ParseHttpDate(cond, date) && date == _lastModified;
+}
+
+// RFC 7233：按Range选出要发的区间。格式不对、区间太多或重叠得比整个文件还大时忽略Range照常回200，
+// 所有区间都落在文件之外回416
+void HttpResponse::SelectRanges_(size_t size)
+{
+    std::string_view spec = _neg.range;
+    if (spec.empty() || spec.size() < 6 || strncasecmp(spec.data(), "bytes=", 6) != 0 || !IfRangeMatches_())
+    {
+        return;
+    }
+    spec.remove_prefix(6);
+    auto number = [](std::string_view digits, unsigned long long &out)
+    {
+        out = 0;
+        if (digits.empty() || digits.size() > 18)
+        {
+            return false;
+        }
+        for (char c : digits)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            out = out * 10 + (c - '0');
+        }
+        return true;
+    };
+    std::vector<Range> ranges;
+    size_t total = 0;
+    while (!spec.empty())
+    {
+        size_t comma = spec.find(',');
+        std::string_view one = HttpRequest::TrimOWS(spec.substr(0, comma));
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        if (one.empty())
+        {
+            continue;
+        }
+        size_t dash = one.find('-');
+        if (dash == std::string_view::npos)
+        {
+            return;
+        }
+        unsigned long long first, last;
+        if (dash == 0)
+        {
+            // 后缀区间"-n"：最后n个字节
+            if (!number(one.substr(1), last))
+            {
+                return;
+            }
+            if (last == 0 || size == 0)
+            {
+                continue;
+            }
+            first = last < size ? size - last : 0;
+            last = size - 1;
+        }
+        else
+        {
+            if (!number(one.substr(0, dash), first))
+            {
+                return;
+            }
+            if (dash + 1 == one.size())
+            {
+                last = size - 1;
+            }
+            else if (!number(one.substr(dash + 1), last) || last < first)
+            {
+                return;
+            }
+            if (first >= size)
+            {
+                continue;
+            }
+            last = std::min<unsigned long long>(last, size - 1);
+        }
+        if (ranges.size() == MAX_RANGES)
+        {
+            return;
+        }
+        ranges.push_back({static_cast<off_t>(first), static_cast<size_t>(last - first + 1), 0});
+        total += ranges.back().len;
+    }
+    if (ranges.empty())
+    {
+        _code = 416;
+        return;
+    }
+    if (total > size)
+    {
+        return;
+    }
+    _code = 206;
+    _ranges.swap(ranges);
+    if (_ranges.size() == 1)
+    {
+        return;
+    }
+    static std::atomic<uint64_t> boundarySeq(static_cast<uint64_t>(time(nullptr)) << 20);
+    char boundary[24];
+    snprintf(boundary, sizeof(boundary), "%020llu", static_cast<unsigned long long>(boundarySeq++));
+    _boundary = boundary;
+    std::string type = GetFileType();
+    for (Range &range : _ranges)
+    {
+        size_t begin = _parts.size();
+        _parts += "\r\n--" + _boundary + "\r\nContent-type: " + type + "\r\nContent-Range: bytes " +
+                  std::to_string(range.off) + "-" + std::to_string(range.off + range.len - 1) + "/" +
+                  std::to_string(size) + "\r\n\r\n";
+        range.headerLen = _parts.size() - begin;
+    }
+    _parts += "\r\n--" + _boundary + "--\r\n";
+}
+
+// 正文长度和206/416的Content-Range，结束响应头；size为整个文件的长度
+void HttpResponse::AddLength_(ChainBuffer &buff, size_t size)
+{
+    size_t len = size;
+    if (_code == 416)
+    {
+        buff.Append("Content-Range: bytes */" + std::to_string(size) + "\r\n");
+        len = 0;
+    }
+    else if (_code == 206 && _ranges.size() == 1)
+    {
+        const Range &range = _ranges.front();
+        buff.Append("Content-Range: bytes " + std::to_string(range.off) + "-" +
+                    std::to_string(range.off + range.len - 1) + "/" + std::to_string(size) + "\r\n");
+        len = range.len;
+    }
+    else if (_code == 206)
+    {
+        len = _parts.size();
+        for (const Range &range : _ranges)
+        {
+            len += range.len;
+        }
+    }
+    buff.Append("Content-length: " + std::to_string(len) + "\r\n\r\n");
+}
+
+// 释放正文占用的资源：mmap映射、sendfile保持打开的文件或缓存条目的引用
 void HttpResponse::UnmapFile()
 {
+    _cached.reset();
     if (_mmFile)
     {
         munmap(_mmFile, _mmFileStat.st_size);
         _mmFile = nullptr;
     }
+    if (_fileFd >= 0)
+    {
+        close(_fileFd);
+        _fileFd = -1;
+    }
 }
 
 // std::string HttpResponse::GetFileType()
@@ -257,12 +715,24 @@ std::string HttpResponse::GetFileType()
     auto it = _SUFFIX_TYPE.find(suffixView.data());
     if (it != _SUFFIX_TYPE.end())
     {
-        return it->second;
+        return it->second.mime;
     }
     return "text/plain";
 }
 
-void HttpResponse::ErrorContent(Buffer &buff, std::string message)
+const std::string &HttpResponse::CacheControl_() const
+{
+    static const std::string none;
+    size_t idx = _path.find_last_of('.');
+    if (idx == std::string::npos)
+    {
+        return none;
+    }
+    auto it = _SUFFIX_TYPE.find(_path.substr(idx));
+    return it != _SUFFIX_TYPE.end() ? it->second.cacheControl : none;
+}
+
+void HttpResponse::ErrorContent(ChainBuffer &buff, std::string message)
 {
     std::string body;
     std::string status;
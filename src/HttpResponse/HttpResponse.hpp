@@ -2,51 +2,160 @@
 #define HTTPRESPONSE_HPP
 
 #include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <strings.h>
+#include <atomic>
 
-#include "../Buffer/Buffer.hpp"
+#include "../Buffer/ChainBuffer.hpp"
+#include "../HttpRequest/HttpRequest.hpp"
 #include "../Log/Log.hpp"
+#include "../FileCache/FileCache.hpp"
+#include "../TimeCache/TimeCache.hpp"
 
 class HttpResponse
 {
 public:
+    // 请求里影响响应内容的部分。视图指向读缓冲，只在MakeResponse期间有效
+    struct Negotiation
+    {
+        bool acceptGzip;
+        std::string_view ifNoneMatch;
+        std::string_view ifModifiedSince;
+        std::string_view range;
+        std::string_view ifRange;
+    };
+
     HttpResponse();
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
-    void MakeResponse(Buffer &buff);
+    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1,
+              const Negotiation &neg = Negotiation());
+    void MakeResponse(ChainBuffer &buff);
+    // 正文在内存里生成、不对应任何文件的200响应(如指标页)，响应头和正文都写进buff，type为Content-type
+    void MakeContent(ChainBuffer &buff, const std::string &body, const char *type);
     void UnmapFile();
     char *File();
     // std::unique_ptr<char[]> File();
+    int FileFd() const;
     size_t FileLen() const;
-    void ErrorContent(Buffer &buff, std::string message);
+    // 按发送顺序给出正文的各段：内存里的调用mem(data, len)，要用sendfile发的调用file(fd, off, len)。
+    // 200是整个文件一段；206是各个区间，多区间时前后穿插multipart的分段头
+    template <typename M, typename F>
+    void ForEachPiece(M &&mem, F &&file) const;
+    void ErrorContent(ChainBuffer &buff, std::string message);
     int Code() const;
 
+    static size_t sendfileThreshold; // 不小于该大小的文件走sendfile零拷贝，更小的文件仍然mmap
+    static const size_t MAX_RANGES = 16; // 一个Range头最多接受的区间数，更多的整体忽略、回200
+
 private:
-    void AddStateLine_(Buffer &buff);
-    void AddHeader_(Buffer &buff);
-    void AddContent_(Buffer &buff);
+    void AddStateLine_(ChainBuffer &buff);
+    void AddHeader_(ChainBuffer &buff, const char *type = nullptr); // type为空时按后缀取Content-type
+    void AddContent_(ChainBuffer &buff);
+    bool LoadCached_();
+    void AddCachedHeader_(ChainBuffer &buff);
+    std::string CachedHeader_(bool isKeepAlive, bool gzip, size_t len);
+    bool Compressible_() const;
+    void UseGzipSibling_();
+    void SendCached_(ChainBuffer &buff);
+    void SetValidators_(const struct timespec &mtime, off_t size);
+    bool NotModified_() const;
+    void AddNotModified_(ChainBuffer &buff);
+    bool IfRangeMatches_() const;
+    void SelectRanges_(size_t size);
+    void AddLength_(ChainBuffer &buff, size_t size);
+    const char *Body_() const;
     // std::unique_ptr<char[]> MapFile(const std::string &path, size_t &fileSize, Buffer &buff);
 
     void ErrorHtml();
     std::string GetFileType();
+    const std::string &CacheControl_() const;
 
     int _code;
     bool _isKeepAlive;
+    Negotiation _neg;
+    bool _gzip; // 本次正文是gzip版本
+    std::string _etag;  // 由文件mtime和大小生成，gzip版本另加后缀；为空表示不带校验头(错误页、生成的页面)
+    time_t _lastModified;
+
+    // 206要发的区间，headerLen为多区间时该区间之前的分段头长度，分段头依次拼在_parts里，末尾是结束边界
+    struct Range
+    {
+        off_t off;
+        size_t len;
+        size_t headerLen;
+    };
+    std::vector<Range> _ranges;
+    std::string _parts;
+    std::string _boundary;
 
     std::string _path;
     std::string _srcDir;
 
     char *_mmFile;
     // std::unique_ptr<char[]> _mmFile;
+    int _fileFd; // sendfile路径下保持打开的文件，由HttpConn::Write发送
+    FileCache::EntryPtr _cached; // 命中文件缓存时正文直接指向缓存条目
     struct stat _mmFileStat;
 
-    static const std::unordered_map<std::string, std::string> _SUFFIX_TYPE;
+    // 按后缀的Content-type和Cache-Control策略，策略为空则不发Cache-Control
+    struct FileType
+    {
+        std::string mime;
+        std::string cacheControl;
+    };
+    static const std::unordered_map<std::string, FileType> _SUFFIX_TYPE;
     static const std::unordered_map<int, std::string> _CODE_STATUS;
     static const std::unordered_map<int, std::string> _CODE_PATH;
+    static const std::unordered_set<std::string> _COMPRESSIBLE; // 值得gzip的文本类后缀，图片、压缩包等本身已压缩
 };
 
+template <typename M, typename F>
+void HttpResponse::ForEachPiece(M &&mem, F &&file) const
+{
+    const char *body = Body_();
+    size_t len = FileLen();
+    if (len == 0 || (!body && _fileFd < 0))
+    {
+        return;
+    }
+    auto piece = [&](off_t off, size_t n)
+    {
+        if (body)
+        {
+            mem(body + off, n);
+        }
+        else
+        {
+            file(_fileFd, off, n);
+        }
+    };
+    if (_code != 206)
+    {
+        piece(0, len);
+        return;
+    }
+    const char *part = _parts.data();
+    for (const Range &range : _ranges)
+    {
+        if (range.headerLen > 0)
+        {
+            mem(part, range.headerLen);
+            part += range.headerLen;
+        }
+        piece(range.off, range.len);
+    }
+    if (part < _parts.data() + _parts.size())
+    {
+        mem(part, _parts.data() + _parts.size() - part);
+    }
+}
+
 #endif // HTTPRESPONSE_HPP
\ No newline at end of file
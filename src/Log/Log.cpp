@@ -1,70 +1,88 @@
 #include "Log.hpp"
 
+#include <errno.h>
+#include <algorithm>
+
+namespace
+{
+    // 线程退出时标记自己的缓冲区，写线程取空后回收
+    struct RingHolder
+    {
+        std::shared_ptr<LogRing> ring;
+        ~RingHolder()
+        {
+            if (ring)
+            {
+                ring->Retire();
+            }
+        }
+    };
+
+    thread_local RingHolder tlsRing;
+
+    const char *LevelTitle(int level)
+    {
+        switch (level)
+        {
+        case 0:
+            return "[debug]: ";
+        case 2:
+            return "[warn] : ";
+        case 3:
+            return "[error]: ";
+        default:
+            return "[info] : ";
+        }
+    }
+}
+
 Log::Log()
-    : _line_count(0),
+    : _path(nullptr),
+      _suffix(nullptr),
+      _line_count(0),
+      _file_part(0),
       _today(0),
+      _fd(-1),
       _is_open(false),
       _level(1),
       _is_async(false),
-      _fp(nullptr),
-      _log_queue(nullptr),
-      _write_thread(nullptr)
+      _is_close(false),
+      _ring_size(MIN_RING_SIZE),
+      _flush_interval_ms(100),
+      _write_thread(nullptr),
+      _wake_pending(false)
 {
 }
 
 Log::~Log()
 {
-    while (!_log_queue->empty())
+    if (_write_thread)
     {
-        _log_queue->flush();
+        {
+            std::lock_guard<std::mutex> locker(_wake_mtx);
+            _is_close = true;
+        }
+        _wake_cond.notify_one();
+        _write_thread->join();
     }
-    _log_queue->Close();
-    _write_thread->join();
-    if (_fp)
+    _is_async = false;
+    std::lock_guard<std::mutex> locker(_mtx);
+    if (_fd >= 0)
     {
-        std::unique_lock<std::mutex> locker(_mtx);
-        Flush();
-        fclose(_fp);
+        close(_fd);
+        _fd = -1;
     }
 }
 
-// Log::~Log() {
-//     if (_log_queue) {
-//         while (!_log_queue->empty()) {
-//             _log_queue->flush();
-//         }
-//         _log_queue->Close();
-//     }
-
-//     if (_write_thread && _write_thread->joinable()) {
-//         _write_thread->join();
-//     }
-
-//     if (_fp) {
-//         std::unique_lock<std::mutex> locker(_mtx);
-//         Flush();
-//         fclose(_fp);
-//     }
-// }
-
+// 异步模式下把各线程缓冲区里已有的日志全部写进文件
 void Log::Flush()
 {
     if (_is_async)
     {
-        _log_queue->flush();
+        Drain_();
     }
-    fflush(_fp);
 }
 
-// void Log::Flush() {
-//     if (_is_async && _log_queue) {
-//         _log_queue->flush();
-//     }
-//     if (_fp) {
-//         fflush(_fp);
-//     }
-// }
-
 void Log::FlushLogThread()
 {
     Log::Instance()->AsyncWrite_();
@@ -76,173 +94,288 @@ Log *Log::Instance()
     return &instance;
 }
 
-void Log::AsyncWrite_()
+LogRing *Log::LocalRing_()
 {
-    std::string str = "";
-    while (_log_queue->pop(str))
+    if (!tlsRing.ring)
     {
-        std::unique_lock<std::mutex> locker(_mtx);
-        fputs(str.c_str(), _fp);
+        std::shared_ptr<LogRing> ring = std::make_shared<LogRing>(_ring_size);
+        std::lock_guard<std::mutex> locker(_ring_mtx);
+        _rings.push_back(ring);
+        tlsRing.ring = std::move(ring);
     }
+    return tlsRing.ring.get();
 }
 
-void Log::Init(int level, const char *path, const char *suffix, int max_queue_capacity)
+void Log::WakeWriter_()
 {
-    _is_open = true;
-    _level = level;
-    _path = path;
-    _suffix = suffix;
+    {
+        std::lock_guard<std::mutex> locker(_wake_mtx);
+        _wake_pending = true;
+    }
+    _wake_cond.notify_one();
+}
 
-    if (max_queue_capacity > 0)
+// 后台写线程：定时或被唤醒后取走所有缓冲区的数据
+void Log::AsyncWrite_()
+{
+    while (true)
     {
-        _is_async = true;
-        if (!_log_queue)
+        bool closing;
         {
-            // std::unique_ptr<BlockQueue<std::string>> new_log_queue(new BlockQueue<std::string>);
-            // _log_queue = std::move(new_log_queue);
-            // std::unique_ptr<std::thread> new_write_thread(new std::thread(AsyncWrite_));
-            // _write_thread = std::move(new_write_thread);
-            _log_queue = std::make_unique<BlockQueue<std::string>>(max_queue_capacity);
-            _write_thread = std::make_unique<std::thread>(&Log::AsyncWrite_, this);
+            std::unique_lock<std::mutex> locker(_wake_mtx);
+            _wake_cond.wait_for(locker, std::chrono::milliseconds(_flush_interval_ms),
+                                [this]
+                                { return _wake_pending || _is_close; });
+            _wake_pending = false;
+            closing = _is_close;
+        }
+        Drain_();
+        if (closing)
+        {
+            break;
         }
     }
-    else
-    {
-        _is_async = false;
-    }
+}
 
-    _line_count = 0;
-    time_t timer = time(nullptr);
-    struct tm *sys_tm = localtime(&timer);
-    char file_name[LOG_NAME_LEN] = {0};
-    snprintf(file_name, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
-             _path, sys_tm->tm_year + 1900, sys_tm->tm_mon + 1, sys_tm->tm_mday, _suffix);
-    _today = sys_tm->tm_mday;
+void Log::Drain_()
+{
+    struct iovec iov[IOV_BATCH];
+    LogRing *owners[IOV_BATCH / 2];
+    size_t bytes[IOV_BATCH / 2];
+    int iovCnt = 0, ringCnt = 0;
 
+    std::lock_guard<std::mutex> locker(_ring_mtx);
+    auto flushBatch = [&]()
     {
-        std::lock_guard<std::mutex> locker(_mtx);
-        _buffer.RetrieveAll();
-        if (_fp)
+        if (iovCnt == 0)
         {
-            Flush();
-            fclose(_fp);
+            return;
         }
-        _fp = fopen(file_name, "a");
-        if (_fp == nullptr)
+        uint64_t lines = 0;
+        for (int i = 0; i < ringCnt; ++i)
         {
-            mkdir(_path, 0777);
-            _fp = fopen(file_name, "a");
-            if (_fp == nullptr)
-            {
-                fprintf(stderr, "Failed to open log file: %s\n", file_name);
-                return;
-            }   
+            lines += owners[i]->TakeLines();
+        }
+        WriteFile_(iov, iovCnt, lines);
+        for (int i = 0; i < ringCnt; ++i)
+        {
+            owners[i]->consume(bytes[i]);
+            owners[i]->ResetSignal();
+        }
+        iovCnt = ringCnt = 0;
+    };
+
+    for (auto &ring : _rings)
+    {
+        int n = ring->peek(&iov[iovCnt], bytes[ringCnt]);
+        if (n == 0)
+        {
+            continue;
+        }
+        owners[ringCnt++] = ring.get();
+        iovCnt += n;
+        if (iovCnt + 2 > IOV_BATCH)
+        {
+            flushBatch();
         }
     }
+    flushBatch();
+
+    // 线程已经退出且数据已取空的缓冲区不再需要
+    _rings.erase(std::remove_if(_rings.begin(), _rings.end(),
+                                [](const std::shared_ptr<LogRing> &ring)
+                                { return ring->Retired() && ring->size() == 0; }),
+                 _rings.end());
 }
 
-void Log::Write(int level, const char *format, ...)
+int Log::OpenFile_(const char *file_name)
 {
-    struct timeval now = {0, 0};
-    gettimeofday(&now, nullptr);
-    time_t t_sec = now.tv_sec;
-    struct tm *sys_tm = localtime(&t_sec);
-    struct tm t = *sys_tm;
-    va_list vaList;
+    int fd = open(file_name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        mkdir(_path, 0777);
+        fd = open(file_name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    }
+    return fd;
+}
 
-    if (_today != t.tm_mday || (_line_count && (_line_count % MAX_LINES == 0)))
+// 按天切分日志文件，同一天内每MAX_LINES行再切一个新文件，调用时需持有_mtx
+void Log::RotateIfNeeded_()
+{
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
+    if (_today == t.tm_mday && _line_count / MAX_LINES == _file_part)
     {
-        std::unique_lock<std::mutex> locker(_mtx);
-        locker.unlock();
+        return;
+    }
+
+    char newFile[LOG_NAME_LEN];
+    char tail[36] = {0};
+    snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    if (_today != t.tm_mday)
+    {
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", _path, tail, _suffix);
+        _today = t.tm_mday;
+        _line_count = 0;
+        _file_part = 0;
+    }
+    else
+    {
+        _file_part = _line_count / MAX_LINES;
+        snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", _path, tail, _file_part, _suffix);
+    }
 
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    int fd = OpenFile_(newFile);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open log file: %s\n", newFile);
+        return;
+    }
+    if (_fd >= 0)
+    {
+        close(_fd);
+    }
+    _fd = fd;
+}
+
+void Log::WriteFile_(const struct iovec *iov, int iovcnt, uint64_t lines)
+{
+    std::lock_guard<std::mutex> locker(_mtx);
+    RotateIfNeeded_();
+    if (_fd < 0)
+    {
+        return;
+    }
+    _line_count += static_cast<int>(lines);
 
-        if (_today != t.tm_mday)
+    struct iovec rest[IOV_BATCH];
+    std::copy(iov, iov + iovcnt, rest);
+    struct iovec *cur = rest;
+    while (iovcnt > 0)
+    {
+        ssize_t len = writev(_fd, cur, iovcnt);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        // 处理部分写入
+        while (iovcnt > 0 && static_cast<size_t>(len) >= cur->iov_len)
         {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", _path, tail, _suffix);
-            _today = t.tm_mday;
-            _line_count = 0;
+            len -= cur->iov_len;
+            cur++;
+            iovcnt--;
         }
-        else
+        if (iovcnt > 0)
         {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", _path, tail, (_line_count / MAX_LINES), _suffix);
+            cur->iov_base = static_cast<char *>(cur->iov_base) + len;
+            cur->iov_len -= len;
         }
-
-        locker.lock();
-        Flush();
-        fclose(_fp);
-        _fp = fopen(newFile, "a");
-        assert(_fp != nullptr);
     }
+}
 
+void Log::Init(int level, const char *path, const char *suffix, int max_queue_capacity, int flush_interval_ms)
+{
+    _level = level;
+    _path = path;
+    _suffix = suffix;
+    _flush_interval_ms = std::max(1, flush_interval_ms);
+
+    if (max_queue_capacity > 0)
     {
-        std::unique_lock<std::mutex> locker(_mtx);
-        _line_count++;
-        // Time
-        int n = snprintf(_buffer.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                         t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-        _buffer.HasWritten(n);
-        // Level
-        AppendLogLevelTitle_(level);
-        // Content
-        va_start(vaList, format);
-        int m = vsnprintf(_buffer.BeginWrite(), _buffer.WritableBytes(), format, vaList);
-        va_end(vaList);
+        size_t want = std::min(std::max(static_cast<size_t>(max_queue_capacity) * AVG_LINE_LEN, MIN_RING_SIZE), MAX_RING_SIZE);
+        size_t ringSize = MIN_RING_SIZE;
+        while (ringSize < want)
+        {
+            ringSize <<= 1;
+        }
+        _ring_size = ringSize; // 只影响之后才开始写日志的线程
+        if (!_write_thread)
+        {
+            _write_thread = std::make_unique<std::thread>(&Log::AsyncWrite_, this);
+        }
+    }
+    // 切换文件前把旧文件该写的写完
+    Flush();
+    _is_async = max_queue_capacity > 0;
 
-        _buffer.HasWritten(m);
-        _buffer.Append("\n\0", 2);
+    time_t timer = time(nullptr);
+    struct tm sys_tm;
+    localtime_r(&timer, &sys_tm);
+    char file_name[LOG_NAME_LEN] = {0};
+    snprintf(file_name, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
+             _path, sys_tm.tm_year + 1900, sys_tm.tm_mon + 1, sys_tm.tm_mday, _suffix);
 
-        if (_is_async && _log_queue && !_log_queue->full())
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _line_count = 0;
+        _file_part = 0;
+        _today = sys_tm.tm_mday;
+        if (_fd >= 0)
         {
-            _log_queue->push_back(_buffer.RetrieveAllToStr());
+            close(_fd);
         }
-        else
+        _fd = OpenFile_(file_name);
+        if (_fd < 0)
         {
-            fputs(_buffer.Peek(), _fp);
+            fprintf(stderr, "Failed to open log file: %s\n", file_name);
+            return;
         }
-        _buffer.RetrieveAll();
     }
+    _is_open = true;
 }
 
-void Log::AppendLogLevelTitle_(int level)
+void Log::Write(int level, const char *format, ...)
 {
-    switch (level)
+    char line[LINE_MAX_LEN];
+    // Time，同一秒内只补微秒
+    int n = static_cast<int>(TimeCache::LogTime(line));
+    // Level
+    memcpy(line + n, LevelTitle(level), 9);
+    n += 9;
+    // Content，末尾留一个字节给换行符
+    va_list vaList;
+    va_start(vaList, format);
+    int room = LINE_MAX_LEN - n - 1;
+    int m = vsnprintf(line + n, room, format, vaList);
+    va_end(vaList);
+    if (m > 0)
     {
-    case 0:
-        _buffer.Append("[debug]: ", 9);
-        break;
-    case 1:
-        _buffer.Append("[info] : ", 9);
-        break;
-    case 2:
-        _buffer.Append("[warn] : ", 9);
-        break;
-    case 3:
-        _buffer.Append("[error]: ", 9);
-        break;
-    default:
-        _buffer.Append("[info] : ", 9);
-        break;
+        n += std::min(m, room - 1);
     }
-}
+    line[n++] = '\n';
 
-int Log::GetLevel()
-{
-    std::lock_guard<std::mutex> locker(_mtx);
-    return _level;
+    bool queued = false;
+    if (_is_async && !_is_close)
+    {
+        LogRing *ring = LocalRing_();
+        while (!(queued = ring->push(line, n)))
+        {
+            if (_is_close)
+            {
+                break;
+            }
+            // 缓冲区满：叫醒写线程腾出空间
+            WakeWriter_();
+            std::this_thread::yield();
+        }
+        if (ring->size() >= ring->capacity() / 2 && ring->TrySignal())
+        {
+            WakeWriter_();
+        }
+    }
+    if (!queued)
+    {
+        struct iovec iov = {line, static_cast<size_t>(n)};
+        WriteFile_(&iov, 1, 1);
+    }
 }
 
 void Log::SetLevel(int level)
 {
-    std::lock_guard<std::mutex> locker(_mtx);
-    _level = level;
+    _level.store(level, std::memory_order_relaxed);
 }
-
-bool Log::IsOpen()
-{
-    std::lock_guard<std::mutex> locker(_mtx);
-    return _is_open;
-}
\ No newline at end of file
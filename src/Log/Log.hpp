@@ -4,45 +4,70 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
 #include <sys/time.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <sys/stat.h>
-#include "BlockQueue.hpp"
-#include "../Buffer/Buffer.hpp"
+#include "LogRing.hpp"
+#include "../TimeCache/TimeCache.hpp"
 
+// 异步模式下每个线程把格式化好的日志行写进自己的LogRing(无锁)，
+// 后台写线程每隔flush_interval_ms或某个缓冲区过半时，把所有缓冲区的数据用一次writev写进文件。
+// 同步模式(队列容量为0)下直接在调用线程里write。
 class Log final
 {
 private:
     Log();
     virtual ~Log();
-    void AppendLogLevelTitle_(int level);
+    LogRing *LocalRing_();
     void AsyncWrite_();
+    void Drain_();
+    void WakeWriter_();
+    void WriteFile_(const struct iovec *iov, int iovcnt, uint64_t lines);
+    void RotateIfNeeded_();
+    int OpenFile_(const char *file_name);
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     static const int MAX_LINES = 50000;
+    static const int LINE_MAX_LEN = 4096;     // 单行日志上限，超出截断
+    static constexpr size_t AVG_LINE_LEN = 128;  // 按平均行长把队列容量(行数)换算成每线程缓冲区大小
+    static constexpr size_t MIN_RING_SIZE = 16 * 1024;
+    static constexpr size_t MAX_RING_SIZE = 1024 * 1024;
+    static const int IOV_BATCH = 64;
 
     const char *_path;
     const char *_suffix;
 
-    int _max_lines;
-
     int _line_count;
+    int _file_part; // 当天按MAX_LINES切分出的文件序号
     int _today;
+    int _fd;
 
-    bool _is_open;
+    std::atomic<bool> _is_open;
+    std::atomic<int> _level;
+    std::atomic<bool> _is_async;
+    std::atomic<bool> _is_close;
 
-    Buffer _buffer;
-    int _level;
-    bool _is_async;
+    size_t _ring_size;
+    int _flush_interval_ms;
+    std::vector<std::shared_ptr<LogRing>> _rings;
+    std::mutex _ring_mtx; // 保护_rings，同时保证同一时刻只有一个消费者
 
-    FILE *_fp;
-    std::unique_ptr<BlockQueue<std::string>> _log_queue;
     std::unique_ptr<std::thread> _write_thread;
-    std::mutex _mtx;
+    std::mutex _wake_mtx;
+    std::condition_variable _wake_cond;
+    bool _wake_pending;
+
+    std::mutex _mtx; // 保护日志文件(_fd/_line_count/_file_part/_today)
 
 public:
     static Log *Instance();
@@ -51,14 +76,21 @@ public:
     void Init(int level,
               const char *path = "./log",
               const char *suffix = ".log",
-              int max_queue_capacity = 1024);
+              int max_queue_capacity = 1024,
+              int flush_interval_ms = 100);
     void Write(int level, const char *format, ...);
     void Flush();
 
-    int GetLevel();
+    int GetLevel() const
+    {
+        return _level.load(std::memory_order_relaxed);
+    }
     void SetLevel(int level);
 
-    bool IsOpen();
+    bool IsOpen() const
+    {
+        return _is_open.load(std::memory_order_relaxed);
+    }
 };
 
 #define LOG_BASE(level, format, ...) \
@@ -66,14 +98,13 @@ public:
         Log* log = Log::Instance();\
         if (log->IsOpen() && log->GetLevel() <= level) {\
             log->Write(level, format, ##__VA_ARGS__); \
-            log->Flush();\
         }\
     } while(0);
 
-#define LOG_DEBUG(format, ...) do {LOG_BASE(0, format, ##__VA_ARGS__)} while(0);    
+#define LOG_DEBUG(format, ...) do {LOG_BASE(0, format, ##__VA_ARGS__)} while(0);
 #define LOG_INFO(format, ...) do {LOG_BASE(1, format, ##__VA_ARGS__)} while(0);
 #define LOG_WARN(format, ...) do {LOG_BASE(2, format, ##__VA_ARGS__)} while(0);
 #define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
 
 
-#endif // LOG_HPP
\ No newline at end of file
+#endif // LOG_HPP
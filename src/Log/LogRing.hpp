@@ -0,0 +1,129 @@
+#ifndef LOGRING_HPP
+#define LOGRING_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <sys/uio.h>
+#include <assert.h>
+
+// 单生产者单消费者的无锁字节环形缓冲区。
+// 每个写日志的线程独占一个作为生产者，后台写线程作为唯一的消费者把数据整段取走。
+// 一行日志要么完整写入，要么因空间不足整行写入失败，所以取走的数据总是以整行结尾。
+class LogRing
+{
+public:
+    explicit LogRing(size_t capacity)
+        : _buf(new char[capacity]), _capacity(capacity), _mask(capacity - 1),
+          _lines(0), _signaled(false), _retired(false), _head(0), _tail(0), _linesTaken(0)
+    {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    LogRing(const LogRing &) = delete;
+    LogRing &operator=(const LogRing &) = delete;
+
+    // 生产者调用，空间不够返回false
+    bool push(const char *data, size_t len)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        if (_capacity - (head - tail) < len)
+        {
+            return false;
+        }
+        size_t off = head & _mask;
+        size_t first = len < _capacity - off ? len : _capacity - off;
+        memcpy(_buf.get() + off, data, first);
+        memcpy(_buf.get(), data + first, len - first);
+        _lines.store(_lines.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        _head.store(head + len, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用，把当前可读的数据(回绕时分成两段)填进iov，返回段数
+    int peek(struct iovec *iov, size_t &bytes) const
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t head = _head.load(std::memory_order_acquire);
+        bytes = head - tail;
+        if (bytes == 0)
+        {
+            return 0;
+        }
+        size_t off = tail & _mask;
+        size_t first = bytes < _capacity - off ? bytes : _capacity - off;
+        iov[0].iov_base = _buf.get() + off;
+        iov[0].iov_len = first;
+        if (first == bytes)
+        {
+            return 1;
+        }
+        iov[1].iov_base = _buf.get();
+        iov[1].iov_len = bytes - first;
+        return 2;
+    }
+
+    // 消费者调用，数据写出后释放空间
+    void consume(size_t bytes)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    // 消费者调用，返回上次调用以来写入的行数(近似值，只用于日志文件切分)
+    uint64_t TakeLines()
+    {
+        uint64_t lines = _lines.load(std::memory_order_relaxed);
+        uint64_t taken = lines - _linesTaken;
+        _linesTaken = lines;
+        return taken;
+    }
+
+    size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    // 超过水位时生产者只唤醒一次写线程，写线程取走数据后复位
+    bool TrySignal()
+    {
+        return !_signaled.load(std::memory_order_relaxed) && !_signaled.exchange(true, std::memory_order_relaxed);
+    }
+
+    void ResetSignal()
+    {
+        _signaled.store(false, std::memory_order_relaxed);
+    }
+
+    // 所属线程退出时调用，写线程取空后将其回收
+    void Retire()
+    {
+        _retired.store(true, std::memory_order_release);
+    }
+
+    bool Retired() const
+    {
+        return _retired.load(std::memory_order_acquire);
+    }
+
+private:
+    std::unique_ptr<char[]> _buf;
+    const size_t _capacity;
+    const size_t _mask;
+
+    std::atomic<uint64_t> _lines;
+    std::atomic<bool> _signaled;
+    std::atomic<bool> _retired;
+
+    alignas(64) std::atomic<size_t> _head; // 生产者写入位置
+    alignas(64) std::atomic<size_t> _tail; // 消费者读取位置
+    uint64_t _linesTaken;                  // 只由消费者访问
+};
+
+#endif // LOGRING_HPP
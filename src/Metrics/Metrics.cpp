@@ -0,0 +1,228 @@
+#include "Metrics.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <algorithm>
+
+const char *const Metrics::PATH = "/__metrics";
+const char *const Metrics::CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+thread_local Metrics::Shard *Metrics::_tlsShard = nullptr;
+
+namespace
+{
+    const char *const STAGE_NAME[] = {"accept", "read", "parse", "build", "write", "sql_acquire", "sql_query"};
+    const char *const COUNTER_NAME[] = {
+        "webserver_connections_accepted_total",
+        "webserver_requests_total",
+        "webserver_read_bytes_total",
+        "webserver_written_bytes_total",
+        "webserver_epoll_wakeups_total",
+        "webserver_epoll_events_total",
+        "webserver_sql_acquire_timeouts_total",
+        "webserver_sql_reconnects_total",
+        "webserver_write_yields_total",
+    };
+    const char *const COUNTER_HELP[] = {
+        "Accepted connections.",
+        "Parsed requests, including bad ones.",
+        "Bytes read from client sockets.",
+        "Bytes written to client sockets, headers and bodies.",
+        "epoll_wait calls that returned events.",
+        "Events returned by epoll_wait.",
+        "SQL borrowers that gave up waiting for a connection.",
+        "SQL connections reopened after a failed ping or a lost connection.",
+        "Writes that stopped at the per-turn quantum with data still pending.",
+    };
+    const char *const VALUE_NAME[] = {"webserver_epoll_events_per_wakeup", "webserver_accepts_per_wakeup",
+                                      "webserver_sql_lookups_per_query"};
+    const char *const VALUE_HELP[] = {"Events returned by one epoll_wait.", "Connections accepted on one listen wakeup.",
+                                      "Login lookups answered by one SELECT."};
+    const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+    void AppendF(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void AppendF(std::string &out, const char *format, ...)
+    {
+        char line[256];
+        va_list vaList;
+        va_start(vaList, format);
+        int n = vsnprintf(line, sizeof(line), format, vaList);
+        va_end(vaList);
+        if (n > 0)
+        {
+            out.append(line, std::min<size_t>(n, sizeof(line) - 1));
+        }
+    }
+}
+
+static_assert(sizeof(STAGE_NAME) / sizeof(STAGE_NAME[0]) == Metrics::STAGE_NUM, "stage names");
+static_assert(sizeof(COUNTER_NAME) / sizeof(COUNTER_NAME[0]) == Metrics::COUNTER_NUM, "counter names");
+static_assert(sizeof(VALUE_NAME) / sizeof(VALUE_NAME[0]) == Metrics::VALUE_NUM, "value names");
+
+Metrics::Shard::Shard()
+{
+    // 原子量不能memset，逐个清零
+    auto reset = [](Histogram &h)
+    {
+        for (auto &b : h.buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+        h.count.store(0, std::memory_order_relaxed);
+        h.sum.store(0, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+    };
+    for (auto &c : counters)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+    for (auto &h : stages)
+    {
+        reset(h);
+    }
+    for (auto &h : values)
+    {
+        reset(h);
+    }
+}
+
+Metrics *Metrics::Instance()
+{
+    static Metrics instance;
+    return &instance;
+}
+
+void Metrics::AddProbe(const char *name, const char *type, const char *help, Probe probe)
+{
+    std::lock_guard<std::mutex> locker(_mtx);
+    _probes.push_back({name, type, help, std::move(probe)});
+}
+
+void Metrics::ClearProbes()
+{
+    std::lock_guard<std::mutex> locker(_mtx);
+    _probes.clear();
+}
+
+// 桶内最大值，分位数按桶上界报告(偏保守)
+uint64_t Metrics::BucketUpper_(int idx)
+{
+    if (idx < static_cast<int>(SUB))
+    {
+        return idx;
+    }
+    int shift = idx / SUB - 1;
+    uint64_t lower = (SUB + idx % SUB) << shift;
+    return lower + (1ull << shift) - 1;
+}
+
+uint64_t Metrics::Quantile_(const Snapshot &s, double q)
+{
+    if (s.count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * s.count));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_NUM; ++i)
+    {
+        seen += s.buckets[i];
+        if (seen >= rank)
+        {
+            return std::min(BucketUpper_(i), s.max);
+        }
+    }
+    return s.max;
+}
+
+// 分片在抓取过程中仍被写入，各项不是同一时刻的严格快照，对监控足够
+void Metrics::Merge_(Snapshot *stages, Snapshot *values, uint64_t *counters)
+{
+    memset(stages, 0, sizeof(Snapshot) * STAGE_NUM);
+    memset(values, 0, sizeof(Snapshot) * VALUE_NUM);
+    memset(counters, 0, sizeof(uint64_t) * COUNTER_NUM);
+    auto merge = [](Snapshot &dst, const Histogram &src)
+    {
+        for (int i = 0; i < BUCKET_NUM; ++i)
+        {
+            dst.buckets[i] += src.buckets[i].load(std::memory_order_relaxed);
+        }
+        dst.count += src.count.load(std::memory_order_relaxed);
+        dst.sum += src.sum.load(std::memory_order_relaxed);
+        dst.max = std::max(dst.max, src.max.load(std::memory_order_relaxed));
+    };
+    for (auto &shard : _shards)
+    {
+        for (int i = 0; i < COUNTER_NUM; ++i)
+        {
+            counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < STAGE_NUM; ++i)
+        {
+            merge(stages[i], shard->stages[i]);
+        }
+        for (int i = 0; i < VALUE_NUM; ++i)
+        {
+            merge(values[i], shard->values[i]);
+        }
+    }
+}
+
+void Metrics::RenderSummary_(std::string &out, const char *name, const char *label,
+                             const Snapshot &s, double scale)
+{
+    const char *sep = label[0] ? "," : "";
+    for (double q : QUANTILES)
+    {
+        AppendF(out, "%s{%s%squantile=\"%g\"} %.9g\n", name, label, sep, q, Quantile_(s, q) * scale);
+    }
+    AppendF(out, "%s{%s%squantile=\"1\"} %.9g\n", name, label, sep, s.max * scale);
+    // 没有标签时省略花括号
+    const char *open = label[0] ? "{" : "";
+    const char *close = label[0] ? "}" : "";
+    AppendF(out, "%s_sum%s%s%s %.9g\n", name, open, label, close, s.sum * scale);
+    AppendF(out, "%s_count%s%s%s %llu\n", name, open, label, close, (unsigned long long)s.count);
+}
+
+void Metrics::Render(std::string &out)
+{
+    std::unique_ptr<Snapshot[]> stages(new Snapshot[STAGE_NUM]);
+    std::unique_ptr<Snapshot[]> values(new Snapshot[VALUE_NUM]);
+    uint64_t counters[COUNTER_NUM];
+
+    // 探针会去拿各模块自己的锁，复制出来在锁外调用，避免与在模块锁内计数的线程互相等待
+    std::vector<ProbeEntry> probes;
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        Merge_(stages.get(), values.get(), counters);
+        probes = _probes;
+    }
+
+    for (int i = 0; i < COUNTER_NUM; ++i)
+    {
+        AppendF(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                COUNTER_NAME[i], COUNTER_HELP[i], COUNTER_NAME[i], COUNTER_NAME[i], (unsigned long long)counters[i]);
+    }
+
+    out += "# HELP webserver_stage_duration_seconds Time spent in each request processing stage.\n"
+           "# TYPE webserver_stage_duration_seconds summary\n";
+    for (int i = 0; i < STAGE_NUM; ++i)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "stage=\"%s\"", STAGE_NAME[i]);
+        RenderSummary_(out, "webserver_stage_duration_seconds", label, stages[i], 1e-9);
+    }
+
+    for (int i = 0; i < VALUE_NUM; ++i)
+    {
+        AppendF(out, "# HELP %s %s\n# TYPE %s summary\n", VALUE_NAME[i], VALUE_HELP[i], VALUE_NAME[i]);
+        RenderSummary_(out, VALUE_NAME[i], "", values[i], 1);
+    }
+
+    for (auto &p : probes)
+    {
+        AppendF(out, "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", p.name, p.help, p.name, p.type, p.name, p.probe());
+    }
+}
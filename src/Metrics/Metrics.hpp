@@ -0,0 +1,214 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <time.h>
+
+// 运行指标：计数器和延迟直方图按线程分片，每个分片只有所属线程写，写入是普通的load+store(无锁前缀)；
+// 抓取时把所有分片相加，以Prometheus文本格式输出。
+// 直方图按HDR方式对数-线性分桶：每个2的幂区间再分SUB个子桶，相对误差不超过1/SUB。
+class Metrics
+{
+public:
+    // 请求处理的各个阶段，单位纳秒
+    enum Stage
+    {
+        ACCEPT,
+        READ,
+        PARSE,
+        BUILD,
+        WRITE,
+        SQL_ACQUIRE,
+        SQL_QUERY,
+        STAGE_NUM,
+    };
+
+    enum Counter
+    {
+        CONN_ACCEPTED,
+        REQUESTS,
+        BYTES_READ,
+        BYTES_WRITTEN,
+        EPOLL_WAKEUPS,
+        EPOLL_EVENTS,
+        SQL_ACQUIRE_TIMEOUTS,
+        SQL_RECONNECTS,
+        WRITE_YIELDS,
+        COUNTER_NUM,
+    };
+
+    // 不是时间的分布量
+    enum Value
+    {
+        EPOLL_EVENTS_PER_WAKEUP,
+        ACCEPTS_PER_WAKEUP,
+        SQL_LOOKUPS_PER_QUERY,
+        VALUE_NUM,
+    };
+
+    // 抓取时才求值的指标，如连接数、队列深度，type为"gauge"或"counter"
+    typedef std::function<double()> Probe;
+
+    static const char *const PATH;         // 指标页面的保留路径
+    static const char *const CONTENT_TYPE; // Prometheus文本格式0.0.4
+
+    static Metrics *Instance();
+
+    static void Add(Counter counter, uint64_t n = 1);
+    static void Observe(Stage stage, uint64_t ns);
+    static void Record(Value value, uint64_t n);
+    static uint64_t NowNs();
+
+    void AddProbe(const char *name, const char *type, const char *help, Probe probe);
+    void ClearProbes();
+    void Render(std::string &out);
+
+private:
+    static const int SUB_BITS = 3;
+    static const uint64_t SUB = 1 << SUB_BITS;
+    static const int MAX_BITS = 40; // 超过2^40(纳秒约18分钟)的值记进最后一个桶
+    static const int BUCKET_NUM = (MAX_BITS - SUB_BITS + 2) * SUB;
+
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[BUCKET_NUM];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    struct Shard
+    {
+        std::atomic<uint64_t> counters[COUNTER_NUM];
+        Histogram stages[STAGE_NUM];
+        Histogram values[VALUE_NUM];
+        Shard();
+    };
+
+    struct ProbeEntry
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        Probe probe;
+    };
+
+    // 合并后的直方图，只在抓取时使用
+    struct Snapshot
+    {
+        uint64_t buckets[BUCKET_NUM];
+        uint64_t count, sum, max;
+    };
+
+    Metrics() = default;
+    ~Metrics() = default;
+
+    static Shard *LocalShard_();
+    static void Bump_(std::atomic<uint64_t> &a, uint64_t n);
+    static void Record_(Histogram &h, uint64_t v);
+    static int BucketOf_(uint64_t v);
+    static uint64_t BucketUpper_(int idx);
+    static uint64_t Quantile_(const Snapshot &s, double q);
+
+    void Merge_(Snapshot *stages, Snapshot *values, uint64_t *counters);
+    static void RenderSummary_(std::string &out, const char *name, const char *label,
+                               const Snapshot &s, double scale);
+
+    std::mutex _mtx; // 保护_shards和_probes
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::vector<ProbeEntry> _probes;
+
+    static thread_local Shard *_tlsShard;
+};
+
+// 记录一个作用域的耗时
+class StageTimer
+{
+public:
+    explicit StageTimer(Metrics::Stage stage) : _stage(stage), _begin(Metrics::NowNs()) {}
+    ~StageTimer()
+    {
+        Metrics::Observe(_stage, Metrics::NowNs() - _begin);
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    Metrics::Stage _stage;
+    uint64_t _begin;
+};
+
+inline uint64_t Metrics::NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+inline void Metrics::Bump_(std::atomic<uint64_t> &a, uint64_t n)
+{
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline Metrics::Shard *Metrics::LocalShard_()
+{
+    if (!_tlsShard)
+    {
+        Metrics *m = Instance();
+        std::unique_ptr<Shard> shard(new Shard());
+        std::lock_guard<std::mutex> locker(m->_mtx);
+        _tlsShard = shard.get();
+        m->_shards.push_back(std::move(shard)); // 线程退出后分片保留，计数不回退
+    }
+    return _tlsShard;
+}
+
+inline void Metrics::Add(Counter counter, uint64_t n)
+{
+    Bump_(LocalShard_()->counters[counter], n);
+}
+
+inline void Metrics::Observe(Stage stage, uint64_t ns)
+{
+    Record_(LocalShard_()->stages[stage], ns);
+}
+
+inline void Metrics::Record(Value value, uint64_t n)
+{
+    Record_(LocalShard_()->values[value], n);
+}
+
+inline int Metrics::BucketOf_(uint64_t v)
+{
+    if (v < SUB)
+    {
+        return static_cast<int>(v);
+    }
+    int msb = 63 - __builtin_clzll(v);
+    if (msb > MAX_BITS)
+    {
+        return BUCKET_NUM - 1;
+    }
+    int shift = msb - SUB_BITS;
+    return static_cast<int>((shift + 1) * SUB + ((v >> shift) & (SUB - 1)));
+}
+
+inline void Metrics::Record_(Histogram &h, uint64_t v)
+{
+    Bump_(h.buckets[BucketOf_(v)], 1);
+    Bump_(h.count, 1);
+    Bump_(h.sum, v);
+    if (v > h.max.load(std::memory_order_relaxed))
+    {
+        h.max.store(v, std::memory_order_relaxed);
+    }
+}
+
+#endif // METRICS_HPP
@@ -11,72 +11,284 @@ SqlConnPool *SqlConnPool::Instance()
     return &pool;
 }
 
-void SqlConnPool::Init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize)
+void SqlConnPool::Init(const char *host, int port, const char *user, const char *pwd, const char *dbName, int connSize,
+                       int minConn, int waitTimeoutMs, int pingIntervalSec)
 {
     assert(connSize > 0);
-    for (int i = 0; i < connSize; ++i)
+    _host = host;
+    _port = port;
+    _user = user;
+    _pwd = pwd;
+    _dbName = dbName;
+    _maxConn = connSize;
+    _minConn = minConn < 0 ? connSize : std::min(minConn, connSize);
+    _waitTimeoutMs = waitTimeoutMs;
+    _pingIntervalMs = std::max(pingIntervalSec, 1) * 1000;
+    _isClose = false;
+    // 数据库暂时连不上也照常启动，后台线程和借用者会继续尝试
+    for (int i = 0; i < _minConn; ++i)
     {
-        MYSQL *conn = nullptr;
-        conn = mysql_init(conn);
-        if (!conn)
+        SqlConn *conn = new SqlConn();
+        if (!Open_(conn))
         {
-            LOG_ERROR("MySQL Init Error!");
-            return;
-        }
-        conn = mysql_real_connect(conn, host, user, pwd, dbName, port, nullptr, 0);
-        if (!conn)
-        {
-            LOG_ERROR("MySQL Conn Error!")
-            return;
+            delete conn;
+            break;
         }
-        _connQue.emplace(conn);
+        conn->idleSinceMs = conn->checkedMs = NowMs_();
+        _idle.push_back(conn);
+        _total++;
     }
-    _MAX_CONN = connSize;
-    sem_init(&_semId, 0, _MAX_CONN);
+    LOG_INFO("SqlConnPool: %d/%d connections opened, max %d", _total, _minConn, _maxConn);
+    _keeper = std::thread(&SqlConnPool::Keeper_, this);
 }
 
-MYSQL *SqlConnPool::GetConn()
+SqlConn *SqlConnPool::GetConn()
 {
-    MYSQL *conn = nullptr;
-    if (_connQue.empty())
+    StageTimer timer(Metrics::SQL_ACQUIRE); // 包括等待归还和新建连接的时间
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_waitTimeoutMs);
+    std::unique_lock<std::mutex> locker(_mtx);
+    while (!_isClose)
     {
-        LOG_WARN("SQLConnPool Busy!");
-        return nullptr;
+        if (!_idle.empty())
+        {
+            SqlConn *conn = _idle.back();
+            _idle.pop_back();
+            return conn;
+        }
+        if (_total < _maxConn)
+        {
+            // 先占住名额再解锁建连，建连期间别的借用者不会超建
+            _total++;
+            locker.unlock();
+            SqlConn *conn = new SqlConn();
+            if (Open_(conn))
+            {
+                return conn;
+            }
+            delete conn;
+            locker.lock();
+            _total--;
+            _cond.notify_one();
+            return nullptr;
+        }
+        if (_cond.wait_until(locker, deadline) == std::cv_status::timeout)
+        {
+            locker.unlock(); // 计数会拿Metrics的锁，而Metrics渲染时会调用拿本池锁的探针
+            LOG_WARN("SQLConnPool Busy! waited %dms", _waitTimeoutMs);
+            Metrics::Add(Metrics::SQL_ACQUIRE_TIMEOUTS);
+            return nullptr;
+        }
     }
-    sem_wait(&_semId);
-    std::lock_guard<std::mutex> locker(_mtx);
-    conn = _connQue.front();
-    _connQue.pop();
-    return conn;
+    return nullptr;
 }
 
-void SqlConnPool::FreeConn(MYSQL *conn)
+// 已断开且没能重连的连接(sql为空)直接丢掉，名额留给下一个借用者重建
+void SqlConnPool::FreeConn(SqlConn *conn)
 {
     assert(conn);
     std::lock_guard<std::mutex> locker(_mtx);
-    _connQue.push(conn);
-    sem_post(&_semId);
+    if (_isClose || !conn->sql)
+    {
+        Destroy_(conn);
+    }
+    else
+    {
+        conn->idleSinceMs = conn->checkedMs = NowMs_();
+        _idle.push_back(conn);
+    }
+    _cond.notify_one();
+}
+
+bool SqlConnPool::Reconnect(SqlConn *conn)
+{
+    Metrics::Add(Metrics::SQL_RECONNECTS);
+    if (Open_(conn))
+    {
+        LOG_INFO("MySQL reconnected");
+        return true;
+    }
+    return false;
+}
+
+// 定期巡检：ping空闲满一个周期的连接，失败的重连；空闲满两个周期且多于minConn的关掉；不足minConn的补上
+void SqlConnPool::Keeper_()
+{
+    std::unique_lock<std::mutex> locker(_mtx);
+    while (!_isClose)
+    {
+        _keeperCond.wait_for(locker, std::chrono::milliseconds(_pingIntervalMs));
+        if (_isClose)
+        {
+            break;
+        }
+        int64_t now = NowMs_();
+        std::vector<SqlConn *> check;
+        for (auto it = _idle.begin(); it != _idle.end();)
+        {
+            if (now - (*it)->idleSinceMs >= 2 * _pingIntervalMs && _total > _minConn)
+            {
+                Destroy_(*it);
+                it = _idle.erase(it);
+            }
+            else if (now - (*it)->checkedMs >= _pingIntervalMs)
+            {
+                check.push_back(*it);
+                it = _idle.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        int lack = _minConn - _total;
+        _total += std::max(lack, 0);
+        locker.unlock();
+
+        std::vector<SqlConn *> alive;
+        for (SqlConn *conn : check)
+        {
+            if (mysql_ping(conn->sql) == 0 || Reconnect(conn))
+            {
+                alive.push_back(conn);
+            }
+            else
+            {
+                LOG_WARN("MySQL ping failed, drop connection");
+                conn->Close();
+                alive.push_back(conn); // 交给FreeConn统一丢弃
+            }
+        }
+        int opened = 0;
+        for (int i = 0; i < lack; ++i)
+        {
+            SqlConn *conn = new SqlConn();
+            if (!Open_(conn))
+            {
+                delete conn;
+                break;
+            }
+            opened++;
+            alive.push_back(conn);
+        }
+
+        locker.lock();
+        _total -= std::max(lack, 0) - opened;
+        now = NowMs_();
+        for (SqlConn *conn : alive)
+        {
+            if (!conn->sql)
+            {
+                Destroy_(conn);
+                continue;
+            }
+            if (conn->idleSinceMs == 0)
+            {
+                conn->idleSinceMs = now; // 新建的
+            }
+            conn->checkedMs = now;
+            _idle.push_front(conn);
+        }
+        _cond.notify_all();
+    }
+}
+
+bool SqlConnPool::Open_(SqlConn *conn)
+{
+    conn->Close();
+    MYSQL *sql = mysql_init(nullptr);
+    if (!sql)
+    {
+        LOG_ERROR("MySQL Init Error!");
+        return false;
+    }
+    // 数据库不可达时连接、读写都会阻塞，给它们设上限
+    unsigned int connectTimeout = CONNECT_TIMEOUT_SEC;
+    unsigned int ioTimeout = IO_TIMEOUT_SEC;
+    mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+    mysql_options(sql, MYSQL_OPT_READ_TIMEOUT, &ioTimeout);
+    mysql_options(sql, MYSQL_OPT_WRITE_TIMEOUT, &ioTimeout);
+    if (!mysql_real_connect(sql, _host.c_str(), _user.c_str(), _pwd.c_str(), _dbName.c_str(), _port, nullptr, 0))
+    {
+        LOG_ERROR("MySQL Conn Error: %s", mysql_error(sql));
+        mysql_close(sql);
+        return false;
+    }
+    conn->sql = sql;
+    conn->Prepare();
+    if (_uniqueName.load() < 0)
+    {
+        int unique = conn->CheckUniqueName();
+        if (unique == 0 && _uniqueName.exchange(0) != 0)
+        {
+            LOG_ERROR("user.username has no UNIQUE key, registration falls back to SELECT then INSERT; "
+                      "run: ALTER TABLE user ADD UNIQUE KEY (username)");
+        }
+        else if (unique > 0)
+        {
+            _uniqueName = 1;
+        }
+    }
+    return true;
+}
+
+// 调用时须持有_mtx
+void SqlConnPool::Destroy_(SqlConn *conn)
+{
+    conn->Close();
+    delete conn;
+    _total--;
 }
 
 void SqlConnPool::ClosePool()
 {
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        if (_isClose)
+        {
+            return;
+        }
+        _isClose = true;
+    }
+    _keeperCond.notify_all();
+    _cond.notify_all();
+    if (_keeper.joinable())
+    {
+        _keeper.join();
+    }
     std::lock_guard<std::mutex> locker(_mtx);
-    while (!_connQue.empty())
+    while (!_idle.empty())
     {
-        auto conn = _connQue.front();
-        _connQue.pop();
-        mysql_close(conn);
+        Destroy_(_idle.front());
+        _idle.pop_front();
     }
     mysql_library_end();
 }
 
+bool SqlConnPool::UniqueName() const
+{
+    return _uniqueName.load(std::memory_order_relaxed) != 0;
+}
+
 int SqlConnPool::GetFreeConnCount()
 {
     std::lock_guard<std::mutex> locker(_mtx);
-    return _connQue.size();
+    return _idle.size();
+}
+
+int SqlConnPool::GetConnCount()
+{
+    std::lock_guard<std::mutex> locker(_mtx);
+    return _total;
 }
 
-SqlConnRAII::SqlConnRAII(MYSQL **sql, SqlConnPool *connpool)
+int64_t SqlConnPool::NowMs_()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+SqlConnRAII::SqlConnRAII(SqlConn **sql, SqlConnPool *connpool)
 {
     assert(connpool);
     *sql = connpool->GetConn();
@@ -90,4 +302,263 @@ SqlConnRAII::~SqlConnRAII()
     {
         _connPool->FreeConn(_sql);
     }
-}
\ No newline at end of file
+}
+
+namespace
+{
+    MYSQL_STMT *PrepareStmt(MYSQL *sql, const std::string &text)
+    {
+        MYSQL_STMT *stmt = mysql_stmt_init(sql);
+        if (!stmt)
+        {
+            LOG_ERROR("mysql_stmt_init error!");
+            return nullptr;
+        }
+        if (mysql_stmt_prepare(stmt, text.data(), text.size()))
+        {
+            LOG_ERROR("Prepare [%s] error: %s", text.c_str(), mysql_stmt_error(stmt));
+            mysql_stmt_close(stmt);
+            return nullptr;
+        }
+        return stmt;
+    }
+
+    void BindString(MYSQL_BIND &bind, const std::string &value, unsigned long &length)
+    {
+        length = value.size();
+        bind.buffer_type = MYSQL_TYPE_STRING;
+        bind.buffer = const_cast<char *>(value.data());
+        bind.buffer_length = value.size();
+        bind.length = &length;
+    }
+}
+
+// 语句准备失败(如表不存在)时对应句柄留空，用到它的查询直接按出错处理
+bool SqlConn::Prepare()
+{
+    std::string in = "?";
+    for (int i = 1; i < LOOKUP_BATCH; ++i)
+    {
+        in += ",?";
+    }
+    selectUser = PrepareStmt(sql, "SELECT username, password FROM user WHERE username=? LIMIT 1");
+    selectUsers = PrepareStmt(sql, "SELECT username, password FROM user WHERE username IN (" + in + ")");
+    insertUser = PrepareStmt(sql, "INSERT INTO user(username, password) VALUES(?, ?)");
+    return selectUser && selectUsers && insertUser;
+}
+
+void SqlConn::Close()
+{
+    for (MYSQL_STMT **stmt : {&selectUser, &selectUsers, &insertUser})
+    {
+        if (*stmt)
+        {
+            mysql_stmt_close(*stmt);
+            *stmt = nullptr;
+        }
+    }
+    if (sql)
+    {
+        mysql_close(sql);
+        sql = nullptr;
+    }
+}
+
+bool SqlConn::LookupUsers(const std::string *names, int n, std::string *pwds, bool *found)
+{
+    unsigned int err = 0;
+    if (LookupOnce_(names, n, pwds, found, err))
+    {
+        return true;
+    }
+    return Recover_(err) && LookupOnce_(names, n, pwds, found, err);
+}
+
+// 查询是幂等的可以直接重试；插入重试时若第一次其实已经成功，会得到重名，按"用户名已存在"返回。
+// 表上没有唯一键时插入不会报重名，先查一次
+int SqlConn::InsertUser(const std::string &name, const std::string &pwd)
+{
+    if (!SqlConnPool::Instance()->UniqueName())
+    {
+        std::string stored;
+        bool found = false;
+        if (!LookupUsers(&name, 1, &stored, &found))
+        {
+            return -1;
+        }
+        if (found)
+        {
+            LOG_INFO("user used!");
+            return 0;
+        }
+    }
+    unsigned int err = 0;
+    int ret = InsertOnce_(name, pwd, err);
+    if (ret < 0 && Recover_(err))
+    {
+        ret = InsertOnce_(name, pwd, err);
+    }
+    return ret;
+}
+
+// 连接级错误(断开、语句句柄失效)时重连；重连失败连接被关闭(sql为空)，归还时由连接池丢弃
+bool SqlConn::Recover_(unsigned int err)
+{
+    bool lost = !sql || err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST || err == CR_CONN_HOST_ERROR ||
+                err == CR_CONNECTION_ERROR || err == ER_UNKNOWN_STMT_HANDLER || err == ER_NEED_REPREPARE;
+    if (!lost)
+    {
+        return false;
+    }
+    LOG_WARN("MySQL connection lost (%u), reconnecting", err);
+    if (SqlConnPool::Instance()->Reconnect(this))
+    {
+        return true;
+    }
+    Close();
+    return false;
+}
+
+// 只认只含username一列的唯一索引(含主键)，联合唯一键挡不住同名
+int SqlConn::CheckUniqueName()
+{
+    MYSQL_STMT *stmt = sql ? PrepareStmt(sql, "SELECT INDEX_NAME, MAX(COLUMN_NAME) FROM information_schema.STATISTICS "
+                                              "WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='user' AND NON_UNIQUE=0 "
+                                              "GROUP BY INDEX_NAME HAVING COUNT(*)=1 AND MAX(COLUMN_NAME)='username'")
+                           : nullptr;
+    if (!stmt)
+    {
+        return -1;
+    }
+    char index[FIELD_LEN], column[FIELD_LEN];
+    unsigned long indexLen = 0, columnLen = 0;
+    MYSQL_BIND out[2];
+    memset(out, 0, sizeof(out));
+    out[0].buffer_type = MYSQL_TYPE_STRING;
+    out[0].buffer = index;
+    out[0].buffer_length = FIELD_LEN;
+    out[0].length = &indexLen;
+    out[1].buffer_type = MYSQL_TYPE_STRING;
+    out[1].buffer = column;
+    out[1].buffer_length = FIELD_LEN;
+    out[1].length = &columnLen;
+
+    int unique = -1;
+    if (mysql_stmt_execute(stmt) || mysql_stmt_bind_result(stmt, out) || mysql_stmt_store_result(stmt))
+    {
+        LOG_ERROR("Check unique key error: %s", mysql_stmt_error(stmt));
+    }
+    else
+    {
+        int ret = mysql_stmt_fetch(stmt);
+        unique = ret == 0 || ret == MYSQL_DATA_TRUNCATED ? 1 : ret == MYSQL_NO_DATA ? 0 : -1;
+        mysql_stmt_free_result(stmt);
+    }
+    mysql_stmt_close(stmt);
+    return unique;
+}
+
+bool SqlConn::LookupOnce_(const std::string *names, int n, std::string *pwds, bool *found, unsigned int &err)
+{
+    assert(n > 0 && n <= LOOKUP_BATCH);
+    for (int i = 0; i < n; ++i)
+    {
+        found[i] = false;
+    }
+    MYSQL_STMT *stmt = n == 1 ? selectUser : selectUsers;
+    if (!stmt)
+    {
+        err = sql ? 0 : CR_SERVER_GONE_ERROR;
+        return false;
+    }
+    int params = n == 1 ? 1 : LOOKUP_BATCH;
+    MYSQL_BIND in[LOOKUP_BATCH];
+    unsigned long inLen[LOOKUP_BATCH];
+    memset(in, 0, sizeof(in));
+    for (int i = 0; i < params; ++i)
+    {
+        BindString(in[i], names[i < n ? i : 0], inLen[i]); // 凑不满一批时用第一个名字补齐参数
+    }
+
+    char user[FIELD_LEN], pwd[FIELD_LEN];
+    unsigned long userLen = 0, pwdLen = 0;
+    MYSQL_BIND out[2];
+    memset(out, 0, sizeof(out));
+    out[0].buffer_type = MYSQL_TYPE_STRING;
+    out[0].buffer = user;
+    out[0].buffer_length = FIELD_LEN;
+    out[0].length = &userLen;
+    out[1].buffer_type = MYSQL_TYPE_STRING;
+    out[1].buffer = pwd;
+    out[1].buffer_length = FIELD_LEN;
+    out[1].length = &pwdLen;
+
+    uint64_t begin = Metrics::NowNs();
+    if (mysql_stmt_bind_param(stmt, in) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, out) || mysql_stmt_store_result(stmt))
+    {
+        err = mysql_stmt_errno(stmt);
+        LOG_ERROR("Lookup users error: %s", mysql_stmt_error(stmt));
+        mysql_stmt_reset(stmt);
+        return false;
+    }
+    int ret;
+    while ((ret = mysql_stmt_fetch(stmt)) == 0 || ret == MYSQL_DATA_TRUNCATED)
+    {
+        if (ret == MYSQL_DATA_TRUNCATED)
+        {
+            continue;
+        }
+        LOG_DEBUG("MYSQL ROW: %.*s", (int)userLen, user);
+        for (int i = 0; i < n; ++i)
+        {
+            // 同一批里可能有重复的名字，全部填上
+            if (!found[i] && names[i].size() == userLen && memcmp(names[i].data(), user, userLen) == 0)
+            {
+                found[i] = true;
+                pwds[i].assign(pwd, pwdLen);
+            }
+        }
+    }
+    if (ret != MYSQL_NO_DATA)
+    {
+        err = mysql_stmt_errno(stmt);
+    }
+    mysql_stmt_free_result(stmt);
+    Metrics::Observe(Metrics::SQL_QUERY, Metrics::NowNs() - begin);
+    Metrics::Record(Metrics::SQL_LOOKUPS_PER_QUERY, n);
+    return ret == MYSQL_NO_DATA;
+}
+
+int SqlConn::InsertOnce_(const std::string &name, const std::string &pwd, unsigned int &err)
+{
+    if (!insertUser)
+    {
+        err = sql ? 0 : CR_SERVER_GONE_ERROR;
+        return -1;
+    }
+    MYSQL_BIND in[2];
+    unsigned long inLen[2];
+    memset(in, 0, sizeof(in));
+    BindString(in[0], name, inLen[0]);
+    BindString(in[1], pwd, inLen[1]);
+
+    uint64_t begin = Metrics::NowNs();
+    int ret = 1;
+    if (mysql_stmt_bind_param(insertUser, in) || mysql_stmt_execute(insertUser))
+    {
+        err = mysql_stmt_errno(insertUser);
+        if (err == ER_DUP_ENTRY)
+        {
+            LOG_INFO("user used!");
+            ret = 0;
+        }
+        else
+        {
+            LOG_ERROR("Insert user error: %s", mysql_stmt_error(insertUser));
+            ret = -1;
+        }
+    }
+    Metrics::Observe(Metrics::SQL_QUERY, Metrics::NowNs() - begin);
+    return ret;
+}
@@ -2,47 +2,111 @@
 #define SQLCONNPOOL_HPP
 
 #include <mysql/mysql.h>
+#include <mysql/mysqld_error.h>
+#include <mysql/errmsg.h>
+#include <atomic>
 #include <string>
-#include <queue>
+#include <deque>
+#include <vector>
 #include <mutex>
-#include <semaphore.h>
+#include <condition_variable>
+#include <chrono>
 #include <thread>
 #include "../Log/Log.hpp"
+#include "../Metrics/Metrics.hpp"
 
+// 连接和它上面预编译好的语句，借出期间归借用者独占。
+// 用户名、密码都以参数绑定传给服务器，不再拼接SQL文本，每条语句只在建连时解析一次。
+// 执行时发现连接已断(服务器重启、主从切换)会就地重连、重新准备语句并重试一次。
+struct SqlConn
+{
+    static const int LOOKUP_BATCH = 8;  // 一条SELECT最多合并的登录查询数
+    static const int FIELD_LEN = 256;   // 结果字段的缓冲区长度，超长的行视为不匹配
+
+    MYSQL *sql = nullptr;
+    MYSQL_STMT *selectUser = nullptr;   // WHERE username=?
+    MYSQL_STMT *selectUsers = nullptr;  // WHERE username IN (?,...)，LOOKUP_BATCH个参数
+    MYSQL_STMT *insertUser = nullptr;   // 依赖username上的唯一键检测重名，注册只需一次往返，启动时检查唯一键是否存在
+    int64_t idleSinceMs = 0;            // 最近一次归还的时间(steady clock)，收缩用
+    int64_t checkedMs = 0;              // 最近一次归还或ping成功的时间，保活用
+
+    bool Prepare();
+    void Close();
+
+    // 按用户名查密码，n <= LOOKUP_BATCH；found[i]、pwds[i]对应names[i]。执行出错返回false
+    bool LookupUsers(const std::string *names, int n, std::string *pwds, bool *found);
+    // 注册新用户：1成功，0用户名已存在，-1出错
+    int InsertUser(const std::string &name, const std::string &pwd);
+    // user表的username上是否有单列唯一键：1有，0没有，-1查询出错
+    int CheckUniqueName();
+
+private:
+    bool LookupOnce_(const std::string *names, int n, std::string *pwds, bool *found, unsigned int &err);
+    int InsertOnce_(const std::string &name, const std::string &pwd, unsigned int &err);
+    bool Recover_(unsigned int err);
+};
+
+// 弹性连接池：启动时建minConn个连接(失败不中止)，借不到时按需建到maxConn个，
+// 后台线程定期ping空闲连接，断开的重连，空闲太久且多于minConn的关掉。
+// 借用者最多等waitTimeoutMs，超时返回nullptr，由调用者按出错处理，数据库故障只拖慢请求而不会卡死工作线程。
 class SqlConnPool
 {
 private:
     SqlConnPool() = default;
     ~SqlConnPool();
 
-    int _MAX_CONN;
+    void Keeper_();
+    bool Open_(SqlConn *conn);
+    void Destroy_(SqlConn *conn);
+    static int64_t NowMs_();
 
-    std::queue<MYSQL *> _connQue;
+    std::string _host, _user, _pwd, _dbName;
+    int _port = 0;
+    int _minConn = 0;
+    int _maxConn = 0;
+    int _waitTimeoutMs = 0;
+    int _pingIntervalMs = 0;
+    int _total = 0; // 已建立的连接数，含借出的和正在建立的
+    std::atomic<int> _uniqueName{-1}; // CheckUniqueName的结果，-1为还没查到，第一个建好的连接负责查
+
+    std::deque<SqlConn *> _idle; // 尾部最近归还，优先借出热的连接，冷的留在头部等收缩
     std::mutex _mtx;
-    sem_t _semId;
+    std::condition_variable _cond;
+    std::condition_variable _keeperCond;
+    std::thread _keeper;
+    bool _isClose = true;
 
 public:
+    static const unsigned int CONNECT_TIMEOUT_SEC = 2;
+    static const unsigned int IO_TIMEOUT_SEC = 5;
+
     static SqlConnPool *Instance();
 
-    MYSQL *GetConn();
-    void FreeConn(MYSQL *conn);
+    SqlConn *GetConn();
+    void FreeConn(SqlConn *conn);
     int GetFreeConnCount();
+    int GetConnCount();
+    // 关闭并重新打开conn，调用者须独占conn
+    bool Reconnect(SqlConn *conn);
+    // 确认username上没有唯一键时为false，注册退回先查后插(并发注册同名仍可能重复)
+    bool UniqueName() const;
 
     void Init(const char *host, int port,
               const char *user, const char *pwd,
-              const char *dbName, int connSize);
+              const char *dbName, int connSize,
+              int minConn = -1, int waitTimeoutMs = 1000, int pingIntervalSec = 30);
     void ClosePool();
 };
 
 class SqlConnRAII
 {
 private:
-    MYSQL *_sql;
+    SqlConn *_sql;
     SqlConnPool *_connPool;
 
 public:
-    SqlConnRAII(MYSQL **sql, SqlConnPool *connpool);
+    SqlConnRAII(SqlConn **sql, SqlConnPool *connpool);
     ~SqlConnRAII();
 };
 
-#endif // SQLCONNPOOL_HPP
\ No newline at end of file
+#endif // SQLCONNPOOL_HPP
@@ -0,0 +1,129 @@
+#include "SqlExecutor.hpp"
+
+SqlExecutor::SqlExecutor() : _maxQueue(0), _isClose(true) {}
+
+SqlExecutor::~SqlExecutor()
+{
+    Close();
+}
+
+SqlExecutor *SqlExecutor::Instance()
+{
+    static SqlExecutor executor;
+    return &executor;
+}
+
+void SqlExecutor::Init(int threadNum, size_t maxQueue)
+{
+    assert(threadNum > 0);
+    std::lock_guard<std::mutex> locker(_mtx);
+    if (!_threads.empty())
+    {
+        return;
+    }
+    _maxQueue = maxQueue;
+    _isClose = false;
+    for (int i = 0; i < threadNum; ++i)
+    {
+        _threads.emplace_back(&SqlExecutor::Run_, this);
+    }
+}
+
+bool SqlExecutor::Submit(Job job)
+{
+    assert(job);
+    return Push_({std::move(job), std::string(), nullptr});
+}
+
+bool SqlExecutor::SubmitLookup(std::string name, LookupDone done)
+{
+    assert(done);
+    return Push_({nullptr, std::move(name), std::move(done)});
+}
+
+bool SqlExecutor::Push_(Task &&task)
+{
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        if (_isClose || _jobs.size() >= _maxQueue)
+        {
+            LOG_WARN("SqlExecutor busy, queue: %d", (int)_jobs.size());
+            return false;
+        }
+        _jobs.push_back(std::move(task));
+    }
+    _cond.notify_one();
+    return true;
+}
+
+// 已提交的任务执行完再退出，保证每个等待结果的连接都能收到通知
+void SqlExecutor::Close()
+{
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _isClose = true;
+    }
+    _cond.notify_all();
+    for (auto &t : _threads)
+    {
+        t.join();
+    }
+    _threads.clear();
+}
+
+size_t SqlExecutor::QueueDepth()
+{
+    std::lock_guard<std::mutex> locker(_mtx);
+    return _jobs.size();
+}
+
+void SqlExecutor::Run_()
+{
+    Task batch[SqlConn::LOOKUP_BATCH];
+    while (true)
+    {
+        int n = 0;
+        {
+            std::unique_lock<std::mutex> locker(_mtx);
+            _cond.wait(locker, [this]
+                       { return _isClose || !_jobs.empty(); });
+            if (_jobs.empty())
+            {
+                return;
+            }
+            do
+            {
+                batch[n++] = std::move(_jobs.front());
+                _jobs.pop_front();
+            } while (!batch[0].job && n < SqlConn::LOOKUP_BATCH && !_jobs.empty() && !_jobs.front().job);
+        }
+        SqlConn *sql = nullptr;
+        SqlConnRAII conn(&sql, SqlConnPool::Instance());
+        if (batch[0].job)
+        {
+            batch[0].job(sql);
+            batch[0].job = nullptr;
+        }
+        else
+        {
+            RunLookups_(sql, batch, n);
+        }
+    }
+}
+
+void SqlExecutor::RunLookups_(SqlConn *conn, Task *batch, int n)
+{
+    std::string names[SqlConn::LOOKUP_BATCH];
+    std::string pwds[SqlConn::LOOKUP_BATCH];
+    bool found[SqlConn::LOOKUP_BATCH];
+    for (int i = 0; i < n; ++i)
+    {
+        names[i] = std::move(batch[i].name);
+    }
+    bool ok = conn && conn->LookupUsers(names, n, pwds, found);
+    for (int i = 0; i < n; ++i)
+    {
+        batch[i].done(ok ? found[i] : -1, pwds[i]);
+        batch[i].done = nullptr;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SQLEXECUTOR_HPP
+#define SQLEXECUTOR_HPP
+
+#include <mysql/mysql.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SQLconnPool.hpp"
+
+// 专门执行SQL的线程组：请求处理线程只提交任务，等连接、查库都在这里阻塞，静态文件请求不会排在查库后面。
+// 每个任务执行时从连接池借一个连接，执行完归还；任务的完成通知(如重新注册epoll事件)在执行器线程上发出。
+// 排在队首的连续登录查询合并成一条SELECT ... IN执行，并发登录时往返次数按批数而不是请求数计。
+class SqlExecutor
+{
+public:
+    // 借不到连接时参数为nullptr，任务自己决定如何失败
+    typedef std::function<void(SqlConn *)> Job;
+    // found: 1查到(pwd为库里的密码)，0用户不存在，-1出错
+    typedef std::function<void(int found, const std::string &pwd)> LookupDone;
+
+    static SqlExecutor *Instance();
+
+    void Init(int threadNum, size_t maxQueue = 4096);
+    // 队列已满或执行器已关闭时返回false，任务不会被执行
+    bool Submit(Job job);
+    bool SubmitLookup(std::string name, LookupDone done);
+    void Close();
+    size_t QueueDepth();
+
+private:
+    SqlExecutor();
+    ~SqlExecutor();
+    // job为空的是登录查询
+    struct Task
+    {
+        Job job;
+        std::string name;
+        LookupDone done;
+    };
+
+    bool Push_(Task &&task);
+    void Run_();
+    void RunLookups_(SqlConn *conn, Task *batch, int n);
+
+    std::deque<Task> _jobs;
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    std::vector<std::thread> _threads;
+    size_t _maxQueue;
+    bool _isClose;
+};
+
+#endif // SQLEXECUTOR_HPP
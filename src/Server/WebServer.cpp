@@ -4,27 +4,66 @@ WebServer::WebServer(
     int port, int trigMode, int timeoutMS, bool OptLinger,
     int sqlPort, const char *sqlUser, const char *sqlPwd,
     const char *dbName, int connPoolNum, int threadNum,
-    bool openLog, int logLevel, int logQueSize) : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-                                                  timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+    bool openLog, int logLevel, int logQueSize,
+    int reactorNum, int fileCacheMB,
+    int listenBacklog, int acceptBudget, int deferAcceptSec,
+    int userCacheSec, int sqlMinConn,
+    int writeQuantumKB, int sndBufKB, int notsentLowatKB) : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS),
+                                                            listenBacklog_(listenBacklog > 0 ? listenBacklog : SOMAXCONN),
+                                                            acceptBudget_(acceptBudget > 0 ? acceptBudget : 64),
+                                                            deferAcceptSec_(deferAcceptSec),
+                                                            sndBuf_(std::max(sndBufKB, 0) * 1024),
+                                                            notsentLowat_(std::max(notsentLowatKB, 0) * 1024),
+                                                            isClose_(false), users_(MAX_FD)
 {
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strcat(srcDir_, "/resources");
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    HttpConn::writeQuantum = static_cast<size_t>(std::max(writeQuantumKB, 0)) * 1024; // 0为不限
     std::cout << "Work Directory: " << srcDir_ << std::endl;
 
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
+    // 日志最先打开，连接池启动时的检查结果才能记下来
+    if (openLog)
+    {
+        Log::Instance()->Init(logLevel, "./log", ".log", logQueSize);
+    }
+    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum, sqlMinConn); // connPoolNum为上限
+    SqlExecutor::Instance()->Init(connPoolNum); // 每个执行线程同时最多占用一个连接
+    FileCache::Instance()->Init(static_cast<size_t>(fileCacheMB) * 1024 * 1024); // 0则关闭文件缓存
+    UserCache::Instance()->Init(userCacheSec * 1000, std::min(userCacheSec, 5) * 1000); // 不存在的用户最多缓存5秒
     InitEventMode_(trigMode);
-    if (!InitSocket_())
+    // 对端已重置的连接上writev/sendfile会触发SIGPIPE，默认动作是结束进程；忽略后按EPIPE出错关闭连接
+    signal(SIGPIPE, SIG_IGN);
+
+    // reactorNum == 0: 主线程一个epoll循环 + 线程池处理读写
+    // reactorNum > 0 : reactorNum个独立事件循环，各自持有SO_REUSEPORT监听套接字，读写解析均在本线程内完成
+    // reactorNum < 0 : 每个CPU核一个事件循环
+    if (reactorNum < 0)
+    {
+        reactorNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (reactorNum == 0)
     {
-        isClose_ = true;
+        threadpool_.reset(new ThreadPool(threadNum));
     }
+    for (int i = 0; i < std::max(reactorNum, 1); i++)
+    {
+        std::unique_ptr<Reactor> r(new Reactor());
+        r->epoller.reset(new Epoller());
+        r->timer.reset(new TimingWheel());
+        if (!InitSocket_(r.get()))
+        {
+            isClose_ = true;
+        }
+        reactors_.push_back(std::move(r));
+    }
+    InitMetrics_();
 
     // 是否打开日志标志
     if (openLog)
     {
-        Log::Instance()->Init(logLevel, "./log", ".log", logQueSize);
         if (isClose_)
         {
             LOG_ERROR("========== Server Init error!==========");
@@ -38,7 +77,16 @@ WebServer::WebServer(
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
             LOG_INFO("LogSys level: %d", logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("SqlConnPool num: %d-%d, ThreadPool num: %d", std::min(sqlMinConn, connPoolNum), connPoolNum,
+                     threadpool_ ? threadNum : 0);
+            LOG_INFO("Reactor num: %d", (int)reactors_.size());
+            LOG_INFO("FileCache: %dMB, UserCache TTL: %ds", fileCacheMB, userCacheSec);
+            LOG_INFO("Listen backlog: %d, accept budget: %d, TCP_DEFER_ACCEPT: %ds",
+                     listenBacklog_, acceptBudget_, deferAcceptSec_);
+            LOG_INFO("Write quantum: %dKB, SO_SNDBUF: %dKB, TCP_NOTSENT_LOWAT: %dKB",
+                     writeQuantumKB, sndBuf_ / 1024, notsentLowat_ / 1024);
+            LOG_INFO("Connection footprint: %zu bytes idle, %zu bytes while serving a request",
+                     HttpConn::IdleBytes(), HttpConn::ActiveBytes());
         }
     }
     std::cout << "WebServer Working on http://127.0.0.1:" << port << "/" << std::endl;
@@ -46,9 +94,17 @@ WebServer::WebServer(
 
 WebServer::~WebServer()
 {
-    close(listenFd_);
     isClose_ = true;
+    Metrics::Instance()->ClearProbes(); // 探针引用了本对象的线程池
+    for (auto &r : reactors_)
+    {
+        if (r->listenFd >= 0)
+        {
+            close(r->listenFd);
+        }
+    }
     free(srcDir_);
+    SqlExecutor::Instance()->Close(); // 先停执行器，再关它借用的连接
     SqlConnPool::Instance()->ClosePool();
 }
 
@@ -78,46 +134,112 @@ void WebServer::InitEventMode_(int trigMode)
     HttpConn::isET = (connEvent_ & EPOLLET);
 }
 
+// 抓取时才求值的指标，其余计数由各处直接记录
+void WebServer::InitMetrics_()
+{
+    Metrics *m = Metrics::Instance();
+    m->AddProbe("webserver_connections", "gauge", "Open client connections.",
+                []
+                { return (double)HttpConn::userCount; });
+    ThreadPool *pool = threadpool_.get();
+    m->AddProbe("webserver_threadpool_queue_depth", "gauge", "Tasks waiting in the thread pool.",
+                [pool]
+                { return pool ? (double)pool->QueueDepth() : 0.0; });
+    m->AddProbe("webserver_sql_free_connections", "gauge", "Idle connections in the SQL pool.",
+                []
+                { return (double)SqlConnPool::Instance()->GetFreeConnCount(); });
+    m->AddProbe("webserver_sql_connections", "gauge", "Open SQL connections, idle and borrowed.",
+                []
+                { return (double)SqlConnPool::Instance()->GetConnCount(); });
+    m->AddProbe("webserver_sql_queue_depth", "gauge", "Queries waiting for an SQL executor thread.",
+                []
+                { return (double)SqlExecutor::Instance()->QueueDepth(); });
+    m->AddProbe("webserver_filecache_bytes", "gauge", "Bytes held by the static file cache.",
+                []
+                { return (double)FileCache::Instance()->Bytes(); });
+    m->AddProbe("webserver_filecache_hits_total", "counter", "Static file cache hits.",
+                []
+                { return (double)FileCache::Instance()->Hits(); });
+    m->AddProbe("webserver_filecache_misses_total", "counter", "Static file cache misses.",
+                []
+                { return (double)FileCache::Instance()->Misses(); });
+    m->AddProbe("webserver_usercache_entries", "gauge", "Users held by the login cache, including negative entries.",
+                []
+                { return (double)UserCache::Instance()->Size(); });
+    m->AddProbe("webserver_usercache_hits_total", "counter", "Logins answered from a cached user record.",
+                []
+                { return (double)UserCache::Instance()->Hits(); });
+    m->AddProbe("webserver_usercache_negative_hits_total", "counter", "Logins rejected from a cached unknown user.",
+                []
+                { return (double)UserCache::Instance()->NegativeHits(); });
+    m->AddProbe("webserver_usercache_misses_total", "counter", "Logins that had to query the user table.",
+                []
+                { return (double)UserCache::Instance()->Misses(); });
+}
+
 void WebServer::Start()
 {
-    int timeMS = -1; /* epoll wait timeout == -1 无事件将阻塞 */
     if (!isClose_)
     {
         LOG_INFO("========== Server start ==========");
     }
+    // 第0个事件循环跑在调用线程上，其余各占一个线程
+    std::vector<std::thread> loops;
+    for (size_t i = 1; i < reactors_.size(); i++)
+    {
+        loops.emplace_back(&WebServer::Loop_, this, reactors_[i].get());
+    }
+    Loop_(reactors_[0].get());
+    for (auto &t : loops)
+    {
+        t.join();
+    }
+}
+
+void WebServer::Loop_(Reactor *r)
+{
+    int timeMS = -1; /* epoll wait timeout == -1 无事件将阻塞 */
     while (!isClose_)
     {
         if (timeoutMS_ > 0)
         {
-            timeMS = timer_->getNextTick(); // 获取下一次的超时等待事件(至少这个时间才会有用户过期，每次关闭超时连接则需要有新的请求进来)
+            timeMS = r->timer->getNextTick(); // 获取下一次的超时等待事件(至少这个时间才会有用户过期，每次关闭超时连接则需要有新的请求进来)
+        }
+        int eventCnt = r->epoller->Wait(timeMS);
+        if (eventCnt > 0)
+        {
+            Metrics::Add(Metrics::EPOLL_WAKEUPS);
+            Metrics::Add(Metrics::EPOLL_EVENTS, eventCnt);
+            Metrics::Record(Metrics::EPOLL_EVENTS_PER_WAKEUP, eventCnt);
         }
-        int eventCnt = epoller_->Wait(timeMS);
         for (int i = 0; i < eventCnt; i++)
         {
             /* 处理事件 */
-            int fd = epoller_->GetEventFd(i);
-            uint32_t events = epoller_->GetEvents(i);
-            if (fd == listenFd_)
+            int fd = r->epoller->GetEventFd(i);
+            uint32_t events = r->epoller->GetEvents(i);
+            if (fd == r->listenFd)
             {
-                DealListen_();
+                DealListen_(r);
             }
             // 表示对应的文件描述符对端关闭了连接，但本地端仍可以发送数据 | 表示对应的文件描述符被挂断 | 表示对应的文件描述符发生了错误
+            else if (r->epoller->GetEventGen(i) != users_[fd].Generation())
+            {
+                // 同一批事件里该连接已被关闭，fd又被新连接复用：事件属于旧连接，丢弃
+                continue;
+            }
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
             {
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+                DealClose_(r, &users_[fd]);
             }
             // 表示对应的文件描述符可以读取数据（非阻塞）
             else if (events & EPOLLIN)
             {
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                DealRead_(r, &users_[fd]);
             }
             // 表示对应的文件描述符可以写入数据（非阻塞）
             else if (events & EPOLLOUT)
             {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                DealWrite_(r, &users_[fd]);
             }
             else
             {
@@ -138,75 +260,161 @@ void WebServer::SendError_(int fd, const char *info)
     close(fd);
 }
 
-void WebServer::CloseConn_(HttpConn *client)
+// 调用者须持有client->Mutex()
+void WebServer::CloseConn_(Reactor *r, HttpConn *client)
 {
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());
-    epoller_->DelFd(client->GetFd());
+    r->epoller->DelFd(client->GetFd());
     client->Close();
 }
 
-void WebServer::AddClient_(int fd, sockaddr_in addr)
+void WebServer::AddClient_(Reactor *r, int fd, sockaddr_in addr)
 {
     assert(fd > 0);
-    users_[fd].Init(fd, addr);
+    HttpConn *client = &users_[fd];
+    {
+        // 关闭旧连接的线程可能还没放开锁
+        std::lock_guard<std::mutex> locker(client->Mutex());
+        client->Init(fd, addr);
+    }
+    uint32_t gen = client->Generation();
     if (timeoutMS_ > 0)
     {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        // 连接已经关闭(fd可能已被复用)时回调什么也不做
+        r->timer->add(fd, timeoutMS_, [this, r, client, gen]
+                      {
+                          if (client->Generation() == gen)
+                          {
+                              DealClose_(r, client);
+                          } });
     }
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    r->epoller->AddFd(fd, EPOLLIN | connEvent_, gen); // fd由accept4创建时已是非阻塞的
+    LOG_INFO("Client[%d] in!", fd);
 }
 
 // 处理监听套接字，主要逻辑是accept新的套接字，并加入timer和epoller中
-void WebServer::DealListen_()
+// 无论LT还是ET，每次唤醒都一直accept到EAGAIN，但最多acceptBudget_个
+void WebServer::DealListen_(Reactor *r)
 {
     struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    do
+    int batch = 0;
+    bool drained = false;
+    while (batch < acceptBudget_)
     {
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
-        if (fd <= 0)
+        uint64_t begin = Metrics::NowNs();
+        socklen_t len = sizeof(addr);
+        int fd = accept4(r->listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
         {
-            return;
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                LOG_WARN("accept4 error: %s", strerror(errno));
+            }
+            drained = true;
+            break;
         }
-        else if (HttpConn::userCount >= MAX_FD)
+        batch++;
+        if (HttpConn::userCount >= MAX_FD || fd >= users_.MaxFd())
         {
             SendError_(fd, "Server busy!");
             LOG_WARN("Clients is full!");
-            return;
+            continue;
         }
-        AddClient_(fd, addr);
-    } while (listenEvent_ & EPOLLET);
+        AddClient_(r, fd, addr);
+        Metrics::Add(Metrics::CONN_ACCEPTED);
+        Metrics::Observe(Metrics::ACCEPT, Metrics::NowNs() - begin);
+    }
+
+    Metrics::Record(Metrics::ACCEPTS_PER_WAKEUP, batch);
+    LOG_DEBUG("Listen[%d]: %d accepts in this wakeup", r->listenFd, batch);
+
+    // 预算用完时队列里可能还有连接：ET模式不会再有新的边沿，重新MOD一次让epoll在就绪时再报告
+    if (!drained && (listenEvent_ & EPOLLET))
+    {
+        r->epoller->ModFd(r->listenFd, listenEvent_ | EPOLLIN);
+    }
 }
 
-// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中
-void WebServer::DealRead_(HttpConn *client)
+// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中（多Reactor模式下直接在本线程处理）
+void WebServer::DealRead_(Reactor *r, HttpConn *client)
 {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client)); // 这是一个右值，bind将参数和函数绑定
+    ExtentTime_(r, client);
+    if (!threadpool_)
+    {
+        std::lock_guard<std::mutex> locker(client->Mutex());
+        OnRead_(r, client);
+        return;
+    }
+    // 只捕获三个指针和代数的lambda可以放进Task的内部存储，提交任务不分配内存(std::bind产生的对象超出std::function的小对象优化)
+    // 任务执行前连接可能已被定时器关闭，带上代数以便丢弃过期任务；代数在锁内检查，检查之后连接不会再被别的线程关闭
+    uint32_t gen = client->Generation();
+    threadpool_->AddTask([this, r, client, gen]
+                         {
+                             std::lock_guard<std::mutex> locker(client->Mutex());
+                             if (client->Generation() == gen)
+                             {
+                                 OnRead_(r, client);
+                             } });
 }
 
-// 处理写事件，主要逻辑是将OnWrite加入线程池的任务队列中
-void WebServer::DealWrite_(HttpConn *client)
+// 处理写事件，主要逻辑是将OnWrite加入线程池的任务队列中（多Reactor模式下直接在本线程处理）
+void WebServer::DealWrite_(Reactor *r, HttpConn *client)
 {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    ExtentTime_(r, client);
+    if (!threadpool_)
+    {
+        std::lock_guard<std::mutex> locker(client->Mutex());
+        OnWrite_(r, client);
+        return;
+    }
+    uint32_t gen = client->Generation();
+    threadpool_->AddTask([this, r, client, gen]
+                         {
+                             std::lock_guard<std::mutex> locker(client->Mutex());
+                             if (client->Generation() == gen)
+                             {
+                                 OnWrite_(r, client);
+                             } });
 }
 
-void WebServer::ExtentTime_(HttpConn *client)
+// 超时或对端挂断时关闭连接。线程池模式下工作线程可能正在处理这个连接，关闭也交给线程池，
+// 在连接锁内进行：Context只在没人使用时释放，由执行关闭的线程放回它自己的池
+void WebServer::DealClose_(Reactor *r, HttpConn *client)
+{
+    assert(client);
+    uint32_t gen = client->Generation();
+    if (!threadpool_)
+    {
+        std::lock_guard<std::mutex> locker(client->Mutex());
+        CloseConn_(r, client);
+        return;
+    }
+    threadpool_->AddTask([this, r, client, gen]
+                         {
+                             std::lock_guard<std::mutex> locker(client->Mutex());
+                             if (client->Generation() == gen)
+                             {
+                                 CloseConn_(r, client);
+                             } });
+}
+
+void WebServer::ExtentTime_(Reactor *r, HttpConn *client)
 {
     assert(client);
     if (timeoutMS_ > 0)
     {
-        timer_->adjust(client->GetFd(), timeoutMS_);
+        r->timer->adjust(client->GetFd(), timeoutMS_);
     }
 }
 
-void WebServer::OnRead_(HttpConn *client)
+void WebServer::OnRead_(Reactor *r, HttpConn *client)
 {
     assert(client);
     int ret = -1;
@@ -214,32 +422,128 @@ void WebServer::OnRead_(HttpConn *client)
     ret = client->Read(&readErrno); // 读取客户端套接字的数据，读到httpconn的读缓存区
     if (ret <= 0 && readErrno != EAGAIN)
     { // 读异常就关闭客户端
-        CloseConn_(client);
+        CloseConn_(r, client);
         return;
     }
     // 业务逻辑的处理（先读后处理）
-    OnProcess(client);
+    OnProcess(r, client);
 }
 
 /* 处理读（请求）数据的函数 */
-void WebServer::OnProcess(HttpConn *client)
+void WebServer::OnProcess(Reactor *r, HttpConn *client)
 {
-    // 首先调用process()进行逻辑处理
-    if (client->process())
+    // 首先调用process()进行逻辑处理；登录命中用户缓存时当场给出结果，接着处理
+    bool ready = client->process();
+    while (!ready && client->WaitingAuth() && AuthFromCache_(client))
+    {
+        ready = client->process();
+    }
+    if (ready)
     {                                                            // 根据返回的信息重新将fd置为EPOLLOUT（写）或EPOLLIN（读）
                                                                  // 读完事件就跟内核说可以写了
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT); // 响应成功，修改监听事件为写,等待OnWrite_()发送
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client->Generation()); // 响应成功，修改监听事件为写,等待OnWrite_()发送
+    }
+    else if (client->WaitingAuth())
+    {
+        Authenticate_(r, client);
     }
     else
     {
         // 写完事件就跟内核说可以读了
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLIN, client->Generation());
+    }
+}
+
+bool WebServer::AuthFromCache_(HttpConn *client)
+{
+    std::string name, pwd, stored;
+    bool isLogin;
+    client->AuthQuery(name, pwd, isLogin);
+    if (!isLogin || name.empty())
+    {
+        return false;
+    }
+    UserCache::RESULT res = UserCache::Instance()->Get(name, stored);
+    if (res == UserCache::MISS)
+    {
+        return false;
+    }
+    return client->FinishAuth(res == UserCache::FOUND && !pwd.empty() && stored == pwd);
+}
+
+// 登录/注册交给SQL执行器，查询期间连接不监听任何事件(EPOLLONESHOT已消耗)，本线程直接去处理别的连接。
+// 查询完成后在执行器线程上持连接锁把结果交给连接并注册EPOLLOUT：空闲的套接字立即可写，OnWrite_发现没有待发数据就继续处理请求。
+// 登录只查密码，由执行器和并发的其他登录合并成一次查询；注册是一条INSERT，靠唯一键判断重名。
+void WebServer::Authenticate_(Reactor *r, HttpConn *client)
+{
+    std::string name, pwd;
+    bool isLogin;
+    client->AuthQuery(name, pwd, isLogin);
+    int fd = client->GetFd();
+    uint32_t gen = client->Generation();
+    auto complete = [this, r, client, fd, gen](bool ok)
+    {
+        if (client->Generation() == gen && client->FinishAuth(ok))
+        {
+            r->epoller->ModFd(fd, connEvent_ | EPOLLOUT, gen);
+        }
+    };
+    // 执行器线程上要先拿连接锁：关闭也在锁内进行，代数检查、交结果和注册事件期间fd不会被关闭后复用
+    auto finish = [client, complete](bool ok)
+    {
+        std::lock_guard<std::mutex> locker(client->Mutex());
+        complete(ok);
+    };
+    LOG_DEBUG("Verify name:%s, login:%d", name.c_str(), isLogin);
+    bool queued = false;
+    if (!name.empty() && !pwd.empty())
+    {
+        if (isLogin)
+        {
+            uint64_t stamp = UserCache::Instance()->Stamp(name);
+            queued = SqlExecutor::Instance()->SubmitLookup(name,
+                                                           [finish, name, pwd, stamp](int found, const std::string &stored)
+                                                           {
+                                                               if (found == 1)
+                                                               {
+                                                                   UserCache::Instance()->Put(name, stored, stamp);
+                                                               }
+                                                               else if (found == 0)
+                                                               {
+                                                                   UserCache::Instance()->PutAbsent(name, stamp);
+                                                               }
+                                                               finish(found == 1 && stored == pwd);
+                                                           });
+        }
+        else
+        {
+            queued = SqlExecutor::Instance()->Submit([finish, name, pwd](SqlConn *sql)
+                                                     {
+                                                         int ret = sql ? sql->InsertUser(name, pwd) : -1;
+                                                         if (ret >= 0)
+                                                         {
+                                                             UserCache::Instance()->Erase(name); // 去掉"不存在"的缓存
+                                                         }
+                                                         finish(ret == 1);
+                                                     });
+        }
+    }
+    if (!queued)
+    {
+        // 表单不完整或执行器排满：直接按校验失败响应，不让请求无限期挂起。调用者已持有连接锁
+        complete(false);
     }
 }
 
-void WebServer::OnWrite_(HttpConn *client)
+void WebServer::OnWrite_(Reactor *r, HttpConn *client)
 {
     assert(client);
+    if (client->ToWriteBytes() == 0)
+    {
+        // 没有待发数据：查库完成后的唤醒，接着处理等待中的请求
+        OnProcess(r, client);
+        return;
+    }
     int ret = -1;
     int writeErrno = 0;
     ret = client->Write(&writeErrno);
@@ -248,25 +552,22 @@ void WebServer::OnWrite_(HttpConn *client)
         /* 传输完成 */
         if (client->IsKeepAlive())
         {
-            // OnProcess(client);
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN); // 回归换成监测读事件
+            // 读缓冲里可能还有没处理的流水线请求，有则继续响应，否则回归换成监测读事件
+            OnProcess(r, client);
             return;
         }
     }
-    else if (ret < 0)
-    {
-        if (writeErrno == EAGAIN)
-        { // 缓冲区满了
-            /* 继续传输 */
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
-        }
+    else if (ret > 0 || writeErrno == EAGAIN)
+    { // 缓冲区满了，或LT模式下本轮只写了一部分
+        /* 继续传输 */
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client->Generation());
+        return;
     }
-    CloseConn_(client);
+    CloseConn_(r, client);
 }
 
 /* Create listenFd */
-bool WebServer::InitSocket_()
+bool WebServer::InitSocket_(Reactor *r)
 {
     int ret;
     struct sockaddr_in addr;
@@ -287,61 +588,81 @@ bool WebServer::InitSocket_()
             optLinger.l_linger = 1;
         }
 
-        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-        if (listenFd_ < 0)
+        // 监听套接字直接以非阻塞、exec时关闭的方式创建，省去之后的fcntl
+        r->listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (r->listenFd < 0)
         {
             LOG_ERROR("Create socket error!", port_);
             return false;
         }
 
-        ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+        ret = setsockopt(r->listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
         if (ret < 0)
         {
-            close(listenFd_);
+            close(r->listenFd);
             LOG_ERROR("Init linger error!", port_);
             return false;
         }
     }
 
     int optval = 1;
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, (const void *)&optval, sizeof(int));
+    // SO_REUSEADDR与SO_REUSEPORT是两个独立的选项，不能按位或到一次setsockopt里
+    // 多Reactor模式依赖SO_REUSEPORT让每个事件循环bind同一端口，由内核做连接负载均衡
+    ret = setsockopt(r->listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
+    if (ret != -1)
+    {
+        ret = setsockopt(r->listenFd, SOL_SOCKET, SO_REUSEPORT, (const void *)&optval, sizeof(int));
+    }
     if (ret == -1)
     {
         LOG_ERROR("set socket setsockopt error!");
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
 
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
+    ret = bind(r->listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0)
     {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
 
-    ret = listen(listenFd_, 6);
+    // 连接在数据到达后才出现在accept队列里，只建连不发数据的连接不会唤醒事件循环
+    if (deferAcceptSec_ > 0 &&
+        setsockopt(r->listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &deferAcceptSec_, sizeof(deferAcceptSec_)) < 0)
+    {
+        LOG_WARN("set TCP_DEFER_ACCEPT error!");
+    }
+
+    // 以下两项由accept出来的连接继承。发送缓冲限定每个连接在内核里排队的数据量；
+    // NOTSENT_LOWAT让EPOLLOUT在未发出的数据少于该值时才报告，大文件按网络的实际速度一段段写，而不是一次塞满发送缓冲
+    if (sndBuf_ > 0 && setsockopt(r->listenFd, SOL_SOCKET, SO_SNDBUF, &sndBuf_, sizeof(sndBuf_)) < 0)
+    {
+        LOG_WARN("set SO_SNDBUF error!");
+    }
+    if (notsentLowat_ > 0 &&
+        setsockopt(r->listenFd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &notsentLowat_, sizeof(notsentLowat_)) < 0)
+    {
+        LOG_WARN("set TCP_NOTSENT_LOWAT error!");
+    }
+
+    // 实际队列长度还受/proc/sys/net/core/somaxconn限制
+    ret = listen(r->listenFd, listenBacklog_);
     if (ret < 0)
     {
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
 
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN); // 将监听套接字加入epoller
+    ret = r->epoller->AddFd(r->listenFd, listenEvent_ | EPOLLIN); // 将监听套接字加入epoller
     if (ret == 0)
     {
         LOG_ERROR("Add listen error!");
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
-    SetFdNonblock(listenFd_);
     LOG_INFO("Server port:%d", port_);
     return true;
 }
-
-int WebServer::SetFdNonblock(int fd)
-{
-    assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
-}
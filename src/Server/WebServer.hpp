@@ -2,22 +2,32 @@
 #define WEBSERVER_H
 
 #include <unordered_map>
+#include <vector>
+#include <thread>
+#include <atomic>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include "../Epoller/Epoller.hpp"
-#include "../HeapTimer/HeapTimer.hpp"
+#include "../TimingWheel/TimingWheel.hpp"
 
 #include "../Log/Log.hpp"
 #include "../SQL/SQLconnPool.hpp"
+#include "../SQL/SqlExecutor.hpp"
 #include "../ThreadPool/ThreadPool.hpp"
+#include "../FileCache/FileCache.hpp"
+#include "../UserCache/UserCache.hpp"
+#include "../Metrics/Metrics.hpp"
 
 #include "../HttpConn/HttpConn.hpp"
+#include "../HttpConn/ConnSlab.hpp"
 
 class WebServer
 {
@@ -26,46 +36,65 @@ public:
         int port, int trigMode, int timeoutMS, bool OptLinger,
         int sqlPort, const char *sqlUser, const char *sqlPwd,
         const char *dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        int reactorNum = 0, int fileCacheMB = 64,
+        int listenBacklog = 1024, int acceptBudget = 64, int deferAcceptSec = 0,
+        int userCacheSec = 60, int sqlMinConn = 2,
+        int writeQuantumKB = 256, int sndBufKB = 0, int notsentLowatKB = 0);
 
     ~WebServer();
     void Start();
 
 private:
-    bool InitSocket_();
+    // 一个事件循环：独立的epoll、定时器以及监听套接字，连接表由所有Reactor共用
+    struct Reactor
+    {
+        int listenFd = -1;
+        std::unique_ptr<Epoller> epoller;
+        std::unique_ptr<TimingWheel> timer;
+    };
+
+    bool InitSocket_(Reactor *r);
     void InitEventMode_(int trigMode);
-    void AddClient_(int fd, sockaddr_in addr);
+    void InitMetrics_();
+    void AddClient_(Reactor *r, int fd, sockaddr_in addr);
 
-    void DealListen_();
-    void DealWrite_(HttpConn *client);
-    void DealRead_(HttpConn *client);
+    void Loop_(Reactor *r);
+    void DealListen_(Reactor *r);
+    void DealWrite_(Reactor *r, HttpConn *client);
+    void DealRead_(Reactor *r, HttpConn *client);
+    void DealClose_(Reactor *r, HttpConn *client);
 
     void SendError_(int fd, const char *info);
-    void ExtentTime_(HttpConn *client);
-    void CloseConn_(HttpConn *client);
+    void ExtentTime_(Reactor *r, HttpConn *client);
+    void CloseConn_(Reactor *r, HttpConn *client);
 
-    void OnRead_(HttpConn *client);
-    void OnWrite_(HttpConn *client);
-    void OnProcess(HttpConn *client);
+    void OnRead_(Reactor *r, HttpConn *client);
+    void OnWrite_(Reactor *r, HttpConn *client);
+    void OnProcess(Reactor *r, HttpConn *client);
+    bool AuthFromCache_(HttpConn *client);
+    void Authenticate_(Reactor *r, HttpConn *client);
 
     static const int MAX_FD = 65536;
 
-    static int SetFdNonblock(int fd);
-
     int port_;
     bool openLinger_;
     int timeoutMS_; /* 毫秒MS */
-    bool isClose_;
-    int listenFd_;
+    int listenBacklog_;
+    int acceptBudget_;   // 每次唤醒最多accept的连接数，避免建连洪峰饿死已有连接的读写
+    int deferAcceptSec_; // TCP_DEFER_ACCEPT秒数，0为关闭
+    int sndBuf_;         // SO_SNDBUF字节数，0为内核自动调节
+    int notsentLowat_;   // TCP_NOTSENT_LOWAT字节数，0为不设置
+    std::atomic<bool> isClose_;
     char *srcDir_;
 
     uint32_t listenEvent_; // 监听事件
     uint32_t connEvent_;   // 连接事件
 
-    std::unique_ptr<HeapTimer> timer_;
-    std::unique_ptr<ThreadPool> threadpool_;
-    std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    ConnSlab users_; // 以fd为下标的连接表
+
+    std::unique_ptr<ThreadPool> threadpool_; // 多Reactor模式下为空，读写在事件循环线程内完成
+    std::vector<std::unique_ptr<Reactor>> reactors_;
 };
 
 #endif // WEBSERVER_H
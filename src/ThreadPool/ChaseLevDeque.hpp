@@ -0,0 +1,124 @@
+#ifndef CHASELEVDEQUE_HPP
+#define CHASELEVDEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Chase-Lev工作窃取双端队列(Lê et al., PPoPP'13的C11版本)，定长不扩容。
+// 只有所属线程push/take(栈顶，LIFO)，其他线程steal(栈底，FIFO)。
+// 元素按字存放在原子变量里，窃取者与所属线程并发读写同一槽位也不构成数据竞争，
+// 因此T必须可平凡拷贝且大小是字长的整数倍。
+template <typename T, size_t N>
+class ChaseLevDeque
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(sizeof(T) % sizeof(uintptr_t) == 0, "T must be a whole number of words");
+
+public:
+    ChaseLevDeque() : _top(0), _bottom(0) {}
+
+    // 只能由所属线程调用，满了返回false
+    bool push(const T &item)
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        if (b - t >= static_cast<int64_t>(N))
+        {
+            return false;
+        }
+        Store_(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 只能由所属线程调用
+    bool take(T &item)
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = Load_(b);
+        if (t == b)
+        {
+            // 只剩最后一个，和窃取者竞争
+            bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 任意线程调用，失败(队列空或竞争失败)返回false
+    bool steal(T &item)
+    {
+        int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return false;
+        }
+        T tmp = Load_(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        item = tmp;
+        return true;
+    }
+
+    size_t size() const
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    static const size_t WORDS = sizeof(T) / sizeof(uintptr_t);
+
+    struct Slot
+    {
+        std::atomic<uintptr_t> words[WORDS];
+    };
+
+    void Store_(int64_t i, const T &item)
+    {
+        uintptr_t tmp[WORDS];
+        memcpy(tmp, &item, sizeof(T));
+        Slot &slot = _slots[i & (N - 1)];
+        for (size_t k = 0; k < WORDS; ++k)
+        {
+            slot.words[k].store(tmp[k], std::memory_order_relaxed);
+        }
+    }
+
+    T Load_(int64_t i) const
+    {
+        uintptr_t tmp[WORDS];
+        const Slot &slot = _slots[i & (N - 1)];
+        for (size_t k = 0; k < WORDS; ++k)
+        {
+            tmp[k] = slot.words[k].load(std::memory_order_relaxed);
+        }
+        T item;
+        memcpy(&item, tmp, sizeof(T));
+        return item;
+    }
+
+    alignas(64) std::atomic<int64_t> _top;
+    alignas(64) std::atomic<int64_t> _bottom;
+    Slot _slots[N];
+};
+
+#endif // CHASELEVDEQUE_HPP
@@ -0,0 +1,106 @@
+#ifndef MPMCQUEUE_HPP
+#define MPMCQUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <assert.h>
+
+// 有界无锁多生产者多消费者队列(Dmitry Vyukov的环形队列)。
+// 每个槽位带一个序号，生产者/消费者各自CAS推进位置，槽位数据由序号的acquire/release保护。
+template <typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t capacity = 4096)
+        : _cells(new Cell[capacity]), _mask(capacity - 1), _enqueuePos(0), _dequeuePos(0)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 满了返回false
+    bool push(const T &item)
+    {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 空了返回false
+    bool pop(T &item)
+    {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        size_t enq = _enqueuePos.load(std::memory_order_relaxed);
+        size_t deq = _dequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    const size_t _mask;
+    alignas(64) std::atomic<size_t> _enqueuePos;
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+#endif // MPMCQUEUE_HPP
@@ -0,0 +1,68 @@
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 定长任务对象，替代std::function<void()>。
+// 小的、可平凡拷贝的可调用对象(如只捕获几个指针的lambda)直接放在内部存储里，不分配内存；
+// 其他可调用对象在堆上分配，内部只存指针。Task本身可平凡拷贝，可以按字放进无锁队列。
+// 每个Task只能执行一次，执行后释放堆上的可调用对象。
+class Task
+{
+public:
+    static const size_t INLINE_SIZE = 4 * sizeof(void *);
+
+    Task() : _invoke(nullptr) {}
+
+    template <typename F, typename = typename std::enable_if<
+                              !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+    {
+        typedef typename std::decay<F>::type Fn;
+        if constexpr (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(void *) &&
+                      std::is_trivially_copyable<Fn>::value && std::is_trivially_destructible<Fn>::value)
+        {
+            new (_storage) Fn(std::forward<F>(f));
+            _invoke = [](Task &task)
+            { (*reinterpret_cast<Fn *>(task._storage))(); };
+        }
+        else
+        {
+            Fn *fn = new Fn(std::forward<F>(f));
+            memcpy(_storage, &fn, sizeof(fn));
+            _invoke = [](Task &task)
+            {
+                Fn *fn;
+                memcpy(&fn, task._storage, sizeof(fn));
+                std::unique_ptr<Fn> guard(fn);
+                (*fn)();
+            };
+        }
+    }
+
+    void operator()()
+    {
+        void (*invoke)(Task &) = _invoke;
+        _invoke = nullptr;
+        invoke(*this);
+    }
+
+    explicit operator bool() const
+    {
+        return _invoke != nullptr;
+    }
+
+private:
+    void (*_invoke)(Task &);
+    alignas(void *) unsigned char _storage[INLINE_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<Task>::value, "Task must stay trivially copyable");
+static_assert(sizeof(Task) % sizeof(uintptr_t) == 0, "Task must be a whole number of words");
+
+#endif // TASK_HPP
@@ -1,42 +1,158 @@
 #include "ThreadPool.hpp"
 
-ThreadPool::ThreadPool(size_t num_threads) : _pool(std::make_shared<Pool>())
+thread_local ThreadPool *ThreadPool::_tlsPool = nullptr;
+thread_local size_t ThreadPool::_tlsIndex = 0;
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : _inject(INJECT_SIZE), _is_close(false), _sleepers(0), _epoch(0)
 {
     assert(num_threads > 0);
     for (size_t i = 0; i < num_threads; ++i)
     {
-        std::thread([this]()
-                    {
-            std::unique_lock<std::mutex> locker(_pool->_mtx);
-            while(true)
+        _workers.emplace_back(new Worker());
+    }
+    // 所有Worker就位后再启动线程，窃取时会遍历_workers
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        _workers[i]->thread = std::thread(&ThreadPool::Run_, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> locker(_mtx);
+        _is_close = true;
+        _epoch++;
+    }
+    _cond.notify_all();
+    for (auto &worker : _workers)
+    {
+        worker->thread.join();
+    }
+}
+
+size_t ThreadPool::QueueDepth() const
+{
+    size_t depth = _inject.size();
+    for (auto &worker : _workers)
+    {
+        depth += worker->deque.size();
+    }
+    return depth;
+}
+
+void ThreadPool::Submit_(const Task &task)
+{
+    // 工作线程里提交的任务放进自己的队列，不经过共享的注入队列
+    if (_tlsPool == this && _workers[_tlsIndex]->deque.push(task))
+    {
+        Wake_();
+        return;
+    }
+    while (!_inject.push(task))
+    {
+        // 注入队列满：叫醒所有线程消化任务，让出CPU后重试
+        Wake_();
+        std::this_thread::yield();
+    }
+    Wake_();
+}
+
+void ThreadPool::Wake_()
+{
+    if (_sleepers.load(std::memory_order_seq_cst) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> locker(_mtx);
+            _epoch++;
+        }
+        _cond.notify_one();
+    }
+}
+
+bool ThreadPool::Pop_(size_t index, Task &task)
+{
+    Worker &self = *_workers[index];
+    if (self.deque.take(task))
+    {
+        return true;
+    }
+    if (_inject.pop(task))
+    {
+        Task extra;
+        for (int i = 1; i < INJECT_BATCH && _inject.pop(extra); ++i)
+        {
+            if (!self.deque.push(extra))
             {
-                if (!_pool->_tasks.empty())
-                {
-                    auto task = std::move(_pool->_tasks.front());
-                    _pool->_tasks.pop();
-                    locker.unlock();
-                    task();
-                    locker.lock();
-                }
-                else if (_pool->_is_close)
+                // 本地队列满了就原样放回注入队列
+                while (!_inject.push(extra))
                 {
-                    break;
+                    std::this_thread::yield();
                 }
-                else
-                {
-                    _pool->_cond.wait(locker);
-                }
-            } })
-            .detach();
+                break;
+            }
+        }
+        return true;
+    }
+    for (size_t i = 1; i < _workers.size(); ++i)
+    {
+        if (_workers[(index + i) % _workers.size()]->deque.steal(task))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
-ThreadPool::~ThreadPool()
+bool ThreadPool::HasWork_() const
+{
+    return QueueDepth() > 0;
+}
+
+void ThreadPool::Run_(size_t index)
 {
-    if (_pool)
+    _tlsPool = this;
+    _tlsIndex = index;
+    int spins = 0;
+    Task task;
+    while (true)
     {
-        std::unique_lock<std::mutex> locker(_pool->_mtx);
-        _pool->_is_close = true;
+        if (Pop_(index, task))
+        {
+            task();
+            spins = 0;
+            continue;
+        }
+        if (_is_close)
+        {
+            break;
+        }
+        if (++spins < SPIN_COUNT)
+        {
+            CpuRelax();
+            continue;
+        }
+
+        // 挂起：先登记，再复查一次队列，避免提交者没看到登记而漏掉唤醒
+        uint64_t epoch = _epoch.load(std::memory_order_seq_cst);
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (!HasWork_() && !_is_close)
+        {
+            std::unique_lock<std::mutex> locker(_mtx);
+            _cond.wait(locker, [&]
+                       { return _epoch.load(std::memory_order_relaxed) != epoch; });
+        }
+        _sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        spins = 0;
     }
-    _pool->_cond.notify_all();
 }
@@ -1,43 +1,71 @@
 #ifndef THREADPOOL_HPP
 #define THREADPOOL_HPP
 
-#include <queue>
 #include <condition_variable>
-#include <mutex>
 #include <functional>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
 #include <thread>
 #include <assert.h>
 
+#include "Task.hpp"
+#include "ChaseLevDeque.hpp"
+#include "MpmcQueue.hpp"
+
+// 工作窃取线程池：
+//   - 外部线程(Reactor)提交的任务进入无锁注入队列，工作线程提交的任务进入自己的Chase-Lev双端队列；
+//   - 工作线程先取自己的队列，再从注入队列批量取一些，最后去别的线程那里窃取；
+//   - 取不到任务时先自旋一会，再挂起在条件变量上，提交任务时只有存在挂起线程才加锁唤醒。
 class ThreadPool
 {
 private:
-    struct Pool
+    static const size_t DEQUE_SIZE = 1024;
+    static const size_t INJECT_SIZE = 4096;
+    static const int INJECT_BATCH = 4;  // 从注入队列一次取走的任务数，多出来的放进本地队列供别人窃取
+    static const int SPIN_COUNT = 128;  // 挂起前的自旋次数
+
+    struct Worker
     {
-        std::mutex _mtx;
-        std::condition_variable _cond;
-        bool _is_close;
-        std::queue<std::function<void()>> _tasks;
+        ChaseLevDeque<Task, DEQUE_SIZE> deque;
+        std::thread thread;
     };
-    std::shared_ptr<Pool> _pool;
 
-public:
-    ThreadPool() = default;
-    ThreadPool(ThreadPool &&) = default;
+    void Submit_(const Task &task);
+    void Run_(size_t index);
+    bool Pop_(size_t index, Task &task);
+    bool HasWork_() const;
+    void Wake_();
 
+    std::vector<std::unique_ptr<Worker>> _workers;
+    MpmcQueue<Task> _inject;
+    std::atomic<bool> _is_close;
+    std::atomic<int> _sleepers;
+    std::atomic<uint64_t> _epoch; // 只在持有_mtx时修改，挂起的线程据此判断是否有新任务
+    std::mutex _mtx;
+    std::condition_variable _cond;
+
+    static thread_local ThreadPool *_tlsPool;
+    static thread_local size_t _tlsIndex;
+
+public:
     explicit ThreadPool(size_t num_threads);
-    
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
     ~ThreadPool();
 
     template <typename T>
-    void AddTask(T&& task);
+    void AddTask(T &&task);
+
+    size_t QueueDepth() const;
 };
 
 template <typename T>
 void ThreadPool::AddTask(T &&task)
 {
-    std::unique_lock<std::mutex> locker(_pool->_mtx);
-    _pool->_tasks.emplace(std::forward<T>(task));
-    _pool->_cond.notify_one();
+    Submit_(Task(std::forward<T>(task)));
 }
 
-#endif // THREADPOOL_HPP
\ No newline at end of file
+#endif // THREADPOOL_HPP
@@ -0,0 +1,123 @@
+#include "TimeCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const char *const WEEKDAY[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    const char *const MONTH[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    struct Cache
+    {
+        time_t logSec = -1;
+        char logPrefix[20]; // "YYYY-MM-DD HH:MM:SS."，不含'\0'
+        time_t dateSec = -1;
+        char date[TimeCache::HTTP_DATE_LEN + 1];
+    };
+
+    thread_local Cache cache;
+
+    // 写入n位十进制数，不足补0，超出只保留低n位
+    void PutDigits(char *p, int value, int n)
+    {
+        for (int i = n - 1; i >= 0; --i)
+        {
+            p[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+}
+
+size_t TimeCache::LogTime(char *buf)
+{
+    struct timeval now = {0, 0};
+    gettimeofday(&now, nullptr);
+    if (now.tv_sec != cache.logSec)
+    {
+        struct tm t;
+        localtime_r(&now.tv_sec, &t);
+        char *p = cache.logPrefix;
+        PutDigits(p, t.tm_year + 1900, 4);
+        p[4] = '-';
+        PutDigits(p + 5, t.tm_mon + 1, 2);
+        p[7] = '-';
+        PutDigits(p + 8, t.tm_mday, 2);
+        p[10] = ' ';
+        PutDigits(p + 11, t.tm_hour, 2);
+        p[13] = ':';
+        PutDigits(p + 14, t.tm_min, 2);
+        p[16] = ':';
+        PutDigits(p + 17, t.tm_sec, 2);
+        p[19] = '.';
+        cache.logSec = now.tv_sec;
+    }
+    memcpy(buf, cache.logPrefix, 20);
+    PutDigits(buf + 20, static_cast<int>(now.tv_usec), 6);
+    buf[26] = ' ';
+    return LOG_TIME_LEN;
+}
+
+std::string_view TimeCache::HttpDate()
+{
+    time_t now = time(nullptr);
+    if (now != cache.dateSec)
+    {
+        FormatHttpDate(now, cache.date);
+        cache.dateSec = now;
+    }
+    return std::string_view(cache.date, HTTP_DATE_LEN);
+}
+
+void TimeCache::FormatHttpDate(time_t sec, char *buf)
+{
+    // 不用strftime的%a/%b，避免受locale影响
+    struct tm t;
+    gmtime_r(&sec, &t);
+    snprintf(buf, HTTP_DATE_LEN + 1, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+             WEEKDAY[t.tm_wday % 7], t.tm_mday % 100, MONTH[t.tm_mon % 12], (t.tm_year + 1900) % 10000,
+             t.tm_hour % 100, t.tm_min % 100, t.tm_sec % 100);
+}
+
+bool TimeCache::ParseHttpDate(std::string_view date, time_t &sec)
+{
+    // "Sun, 06 Nov 1994 08:49:37 GMT"，各字段位置固定
+    if (date.size() != HTTP_DATE_LEN || date.substr(3, 2) != ", " || date[7] != ' ' || date[11] != ' ' ||
+        date[16] != ' ' || date[19] != ':' || date[22] != ':' || date.substr(25) != " GMT")
+    {
+        return false;
+    }
+    auto num = [&date](size_t pos, size_t len, int &out)
+    {
+        out = 0;
+        for (size_t i = pos; i < pos + len; ++i)
+        {
+            if (date[i] < '0' || date[i] > '9')
+            {
+                return false;
+            }
+            out = out * 10 + (date[i] - '0');
+        }
+        return true;
+    };
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_mon = -1;
+    for (int i = 0; i < 12; ++i)
+    {
+        if (date.substr(8, 3) == MONTH[i])
+        {
+            t.tm_mon = i;
+        }
+    }
+    int year;
+    if (t.tm_mon < 0 || !num(5, 2, t.tm_mday) || !num(12, 4, year) || !num(17, 2, t.tm_hour) ||
+        !num(20, 2, t.tm_min) || !num(23, 2, t.tm_sec))
+    {
+        return false;
+    }
+    t.tm_year = year - 1900;
+    sec = timegm(&t);
+    return sec != -1;
+}
@@ -0,0 +1,26 @@
+#ifndef TIME_CACHE_H
+#define TIME_CACHE_H
+
+#include <ctime>
+#include <string_view>
+#include <sys/time.h>
+
+// 按线程缓存格式化好的时间字符串，每秒只做一次localtime_r/gmtime_r和格式化。
+// 日志前缀只需每行补上微秒，HTTP的Date头在同一秒内直接复用。
+class TimeCache
+{
+public:
+    static const size_t LOG_TIME_LEN = 27;  // "YYYY-MM-DD HH:MM:SS.uuuuuu "
+    static const size_t HTTP_DATE_LEN = 29; // "Sun, 06 Nov 1994 08:49:37 GMT"
+
+    // 写入本地时间的日志前缀(不含'\0')，buf至少LOG_TIME_LEN字节，返回写入长度
+    static size_t LogTime(char *buf);
+    // RFC 7231 IMF-fixdate格式的当前时间，在本线程下一次调用前有效
+    static std::string_view HttpDate();
+    // 把任意时刻格式化成IMF-fixdate，buf至少HTTP_DATE_LEN + 1字节
+    static void FormatHttpDate(time_t sec, char *buf);
+    // 解析IMF-fixdate(If-Modified-Since等)，格式不对返回false；过时的RFC 850/asctime格式不支持
+    static bool ParseHttpDate(std::string_view date, time_t &sec);
+};
+
+#endif // TIME_CACHE_H
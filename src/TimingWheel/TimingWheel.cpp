@@ -0,0 +1,223 @@
+#include "TimingWheel.hpp"
+
+TimingWheel::TimingWheel(int tickMs, size_t slotNum)
+    : _tickMs(tickMs),
+      _slotMask(slotNum - 1),
+      _pending(slotNum),
+      _current(NowMs_() / tickMs),
+      _count(0),
+      _slots(slotNum + 1, -1),
+      _bitmap(slotNum / 64, 0)
+{
+    assert(tickMs > 0);
+    assert(slotNum >= 64 && (slotNum & (slotNum - 1)) == 0);
+    _nodes.reserve(1024);
+}
+
+TimingWheel::~TimingWheel()
+{
+    clear();
+}
+
+int64_t TimingWheel::NowMs_()
+{
+    return std::chrono::duration_cast<MS>(Clock::now().time_since_epoch()).count();
+}
+
+// 到期时间所在的tick向上取整，保证处理该槽时节点一定已经到期；已经过去的tick放到下一个tick
+int64_t TimingWheel::SlotTick_(int64_t expires) const
+{
+    int64_t tick = (expires + _tickMs - 1) / _tickMs;
+    return tick > _current ? tick : _current + 1;
+}
+
+void TimingWheel::Link_(int id, int64_t tick)
+{
+    TimerNode &node = _nodes[id];
+    size_t slot = tick & _slotMask;
+    node.slot = static_cast<int>(slot);
+    node.prev = -1;
+    node.next = _slots[slot];
+    if (node.next >= 0)
+    {
+        _nodes[node.next].prev = id;
+    }
+    _slots[slot] = id;
+    if (slot != _pending)
+    {
+        _bitmap[slot >> 6] |= (1ULL << (slot & 63));
+    }
+}
+
+void TimingWheel::Unlink_(int id)
+{
+    TimerNode &node = _nodes[id];
+    assert(node.slot >= 0);
+    if (node.prev >= 0)
+    {
+        _nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        _slots[node.slot] = node.next;
+        if (node.next < 0 && static_cast<size_t>(node.slot) != _pending)
+        {
+            _bitmap[node.slot >> 6] &= ~(1ULL << (node.slot & 63));
+        }
+    }
+    if (node.next >= 0)
+    {
+        _nodes[node.next].prev = node.prev;
+    }
+    node.prev = node.next = node.slot = -1;
+}
+
+// 只刷新到期时间，节点留在原来的槽里。
+// 已经到期的忽略：回调可能把关闭交给了线程池，关闭执行前连接上仍会来事件
+void TimingWheel::adjust(int id, int newExpires)
+{
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= _nodes.size() || _nodes[id].slot < 0)
+    {
+        return;
+    }
+    _nodes[id].expires = NowMs_() + newExpires;
+}
+
+void TimingWheel::add(int id, int timeOut, const TimeoutCallBack &cb)
+{
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= _nodes.size())
+    {
+        _nodes.resize(id + 1);
+    }
+    TimerNode &node = _nodes[id];
+    if (node.slot >= 0)
+    {
+        Unlink_(id);
+    }
+    else
+    {
+        _count++;
+    }
+    node.expires = NowMs_() + timeOut;
+    node.cb = cb;
+    Link_(id, SlotTick_(node.expires));
+}
+
+void TimingWheel::cancel(int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= _nodes.size() || _nodes[id].slot < 0)
+    {
+        return;
+    }
+    Unlink_(id);
+    _nodes[id].cb = nullptr;
+    _count--;
+}
+
+void TimingWheel::doWork(int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= _nodes.size() || _nodes[id].slot < 0)
+    {
+        LOG_ERROR("Timer id not found in wheel.");
+        return;
+    }
+    LOG_INFO("Id %d being called.", id);
+    TimeoutCallBack cb = std::move(_nodes[id].cb);
+    cancel(id);
+    cb();
+}
+
+void TimingWheel::tick()
+{
+    int64_t nowMs = NowMs_();
+    int64_t nowTick = nowMs / _tickMs;
+    // 停顿超过一圈时每个槽只需处理一次
+    int64_t slotNum = static_cast<int64_t>(_slotMask + 1);
+    if (nowTick - _current > slotNum)
+    {
+        _current = nowTick - slotNum;
+    }
+    while (_current < nowTick && _count > 0)
+    {
+        _current++;
+        size_t slot = _current & _slotMask;
+        // 先把整条链移到_pending，重新挂回同一个槽的节点本轮不会再被访问
+        _slots[_pending] = _slots[slot];
+        _slots[slot] = -1;
+        _bitmap[slot >> 6] &= ~(1ULL << (slot & 63));
+        for (int id = _slots[_pending]; id >= 0; id = _nodes[id].next)
+        {
+            _nodes[id].slot = static_cast<int>(_pending);
+        }
+        while (_slots[_pending] >= 0)
+        {
+            int id = _slots[_pending];
+            Unlink_(id);
+            TimerNode &node = _nodes[id];
+            if (node.expires <= nowMs)
+            {
+                LOG_INFO("Timer expired, id: %d.", id);
+                _count--;
+                TimeoutCallBack cb = std::move(node.cb);
+                cb(); // 回调里可能add/cancel，之后不能再使用node
+            }
+            else
+            {
+                Link_(id, SlotTick_(node.expires));
+            }
+        }
+    }
+    if (_count == 0)
+    {
+        _current = nowTick;
+    }
+}
+
+int TimingWheel::getNextTick()
+{
+    tick();
+    if (_count == 0)
+    {
+        return -1;
+    }
+    // 从下一个tick开始找第一个非空槽，最多看一圈
+    size_t slotNum = _slotMask + 1;
+    size_t start = (_current + 1) & _slotMask;
+    size_t dist = slotNum;
+    for (size_t i = 0; i <= _bitmap.size(); ++i)
+    {
+        size_t word = ((start >> 6) + i) % _bitmap.size();
+        uint64_t bits = _bitmap[word];
+        if (i == 0)
+        {
+            bits &= ~0ULL << (start & 63);
+        }
+        else if (i == _bitmap.size())
+        {
+            bits &= (start & 63) ? ~(~0ULL << (start & 63)) : 0;
+        }
+        if (bits)
+        {
+            size_t slot = (word << 6) + __builtin_ctzll(bits);
+            dist = (slot + slotNum - start) & _slotMask;
+            break;
+        }
+    }
+    int64_t wait = (_current + 1 + static_cast<int64_t>(dist)) * _tickMs - NowMs_();
+    return wait > 0 ? static_cast<int>(wait) : 0;
+}
+
+void TimingWheel::clear()
+{
+    _nodes.clear();
+    std::fill(_slots.begin(), _slots.end(), -1);
+    std::fill(_bitmap.begin(), _bitmap.end(), 0);
+    _count = 0;
+}
+
+size_t TimingWheel::size() const
+{
+    return _count;
+}
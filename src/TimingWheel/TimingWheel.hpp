@@ -0,0 +1,61 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cassert>
+#include <cstdint>
+
+#include "../Log/Log.hpp"
+
+typedef std::function<void()> TimeoutCallBack;
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::milliseconds MS;
+
+// 哈希时间轮，定时器直接以id(即fd)为下标存放，add/adjust/cancel都是O(1)。
+// 节点挂在"到期tick % 槽数"的槽里(侵入式双向链表)。adjust只改写到期时间，不移动节点：
+// 轮到所在槽时发现还没到期，再按新的到期时间挂到对应的槽(惰性过期)。
+// 非空槽用位图记录，getNextTick只需找下一个置位的槽。
+class TimingWheel
+{
+public:
+    explicit TimingWheel(int tickMs = 100, size_t slotNum = 1024);
+    ~TimingWheel();
+
+    void adjust(int id, int newExpires);
+    void add(int id, int timeOut, const TimeoutCallBack &cb);
+    void cancel(int id);
+    void doWork(int id);
+    void clear();
+    void tick();
+    int getNextTick();
+    size_t size() const;
+
+private:
+    struct TimerNode
+    {
+        int prev = -1;
+        int next = -1;
+        int slot = -1; // -1表示未挂在轮上
+        int64_t expires = 0; // 到期时间(ms)
+        TimeoutCallBack cb;
+    };
+
+    static int64_t NowMs_();
+    int64_t SlotTick_(int64_t expires) const;
+    void Link_(int id, int64_t tick);
+    void Unlink_(int id);
+
+    const int64_t _tickMs;
+    const size_t _slotMask;
+    const size_t _pending; // 额外的一个槽，存放本tick正在处理的节点，回调里cancel别的节点也能正常摘链
+    int64_t _current; // 已处理到的tick
+    size_t _count;
+
+    std::vector<TimerNode> _nodes; // 以id为下标
+    std::vector<int> _slots;       // 每个槽链表的表头id，最后一个是_pending
+    std::vector<uint64_t> _bitmap; // 非空槽位图(不含_pending)
+};
+
+#endif // TIMING_WHEEL_H
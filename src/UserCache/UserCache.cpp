@@ -0,0 +1,191 @@
+#include "UserCache.hpp"
+
+UserCache::UserCache()
+    : _shardEntries(0),
+      _ttlMs(0),
+      _negativeTtlMs(0),
+      _isOpen(false),
+      _hits(0),
+      _negativeHits(0),
+      _misses(0)
+{
+}
+
+UserCache *UserCache::Instance()
+{
+    static UserCache instance;
+    return &instance;
+}
+
+void UserCache::Init(int ttlMs, int negativeTtlMs, size_t maxEntries, int shardNum)
+{
+    assert(shardNum > 0);
+    _shards.clear();
+    for (int i = 0; i < shardNum; ++i)
+    {
+        _shards.emplace_back(new Shard());
+    }
+    _shardEntries = std::max<size_t>(maxEntries / shardNum, 1);
+    _ttlMs = ttlMs;
+    _negativeTtlMs = negativeTtlMs;
+    _isOpen = ttlMs > 0 && maxEntries > 0;
+}
+
+bool UserCache::IsOpen() const
+{
+    return _isOpen;
+}
+
+UserCache::RESULT UserCache::Get(const std::string &name, std::string &pwd)
+{
+    if (!_isOpen)
+    {
+        return MISS;
+    }
+    Shard &shard = ShardOf_(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.index.find(name);
+    if (it == shard.index.end())
+    {
+        _misses++;
+        return MISS;
+    }
+    if (it->second->expireMs <= NowMs_())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        _misses++;
+        return MISS;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    if (!it->second->exists)
+    {
+        _negativeHits++;
+        return ABSENT;
+    }
+    pwd = it->second->pwd;
+    _hits++;
+    return FOUND;
+}
+
+uint64_t UserCache::Stamp(const std::string &name)
+{
+    if (!_isOpen)
+    {
+        return 0;
+    }
+    Shard &shard = ShardOf_(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    return shard.erased;
+}
+
+void UserCache::Put(const std::string &name, const std::string &pwd, uint64_t stamp)
+{
+    Insert_(name, pwd, true, stamp);
+}
+
+void UserCache::PutAbsent(const std::string &name, uint64_t stamp)
+{
+    if (_negativeTtlMs > 0)
+    {
+        Insert_(name, std::string(), false, stamp);
+    }
+}
+
+void UserCache::Erase(const std::string &name)
+{
+    if (!_isOpen)
+    {
+        return;
+    }
+    Shard &shard = ShardOf_(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    shard.erased++;
+    auto it = shard.index.find(name);
+    if (it != shard.index.end())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+void UserCache::Clear()
+{
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        shard->erased++;
+        shard->index.clear();
+        shard->lru.clear();
+    }
+}
+
+size_t UserCache::Size()
+{
+    size_t size = 0;
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        size += shard->index.size();
+    }
+    return size;
+}
+
+uint64_t UserCache::Hits() const
+{
+    return _hits;
+}
+
+uint64_t UserCache::NegativeHits() const
+{
+    return _negativeHits;
+}
+
+uint64_t UserCache::Misses() const
+{
+    return _misses;
+}
+
+UserCache::Shard &UserCache::ShardOf_(const std::string &name)
+{
+    return *_shards[std::hash<std::string>()(name) % _shards.size()];
+}
+
+void UserCache::Insert_(const std::string &name, const std::string &pwd, bool exists, uint64_t stamp)
+{
+    if (!_isOpen)
+    {
+        return;
+    }
+    Shard &shard = ShardOf_(name);
+    int64_t expireMs = NowMs_() + (exists ? _ttlMs : _negativeTtlMs);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    if (shard.erased != stamp)
+    {
+        // 查询期间有注册(或清空)落在这个分片上，结果可能已过时
+        return;
+    }
+    auto it = shard.index.find(name);
+    if (it != shard.index.end())
+    {
+        it->second->pwd = pwd;
+        it->second->exists = exists;
+        it->second->expireMs = expireMs;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    shard.lru.push_front({name, pwd, exists, expireMs});
+    shard.index[name] = shard.lru.begin();
+    if (shard.index.size() > _shardEntries)
+    {
+        shard.index.erase(shard.lru.back().name);
+        shard.lru.pop_back();
+    }
+}
+
+int64_t UserCache::NowMs_()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
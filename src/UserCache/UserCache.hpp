@@ -0,0 +1,82 @@
+#ifndef USERCACHE_HPP
+#define USERCACHE_HPP
+
+#include <string>
+#include <list>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <assert.h>
+
+#include "../Log/Log.hpp"
+
+// 登录用的用户记录缓存：用户名 -> user表里的password字段，按用户名分片，每片一把锁 + LRU链表，条目数受上限约束。
+// 不存在的用户也缓存(较短的TTL)，重复的错误登录不再查库。注册后删除对应条目。
+// 查库和注册可能交错：查询前取Stamp()，写回时分片的失效计数变了就放弃写回，避免注册之前查到的"不存在"盖住新用户。
+class UserCache
+{
+public:
+    enum RESULT
+    {
+        MISS,
+        FOUND,
+        ABSENT,
+    };
+
+    static UserCache *Instance();
+
+    void Init(int ttlMs, int negativeTtlMs, size_t maxEntries = 65536, int shardNum = 16);
+    bool IsOpen() const;
+
+    RESULT Get(const std::string &name, std::string &pwd);
+    uint64_t Stamp(const std::string &name);
+    void Put(const std::string &name, const std::string &pwd, uint64_t stamp);
+    void PutAbsent(const std::string &name, uint64_t stamp);
+    void Erase(const std::string &name);
+    void Clear();
+
+    size_t Size();
+    uint64_t Hits() const;
+    uint64_t NegativeHits() const;
+    uint64_t Misses() const;
+
+private:
+    UserCache();
+    ~UserCache() = default;
+
+    struct Entry
+    {
+        std::string name;
+        std::string pwd;
+        bool exists;
+        int64_t expireMs; // steady clock
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::list<Entry> lru; // 表头最近使用
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        uint64_t erased = 0; // Erase次数，Stamp()即取这个值
+    };
+
+    Shard &ShardOf_(const std::string &name);
+    void Insert_(const std::string &name, const std::string &pwd, bool exists, uint64_t stamp);
+    static int64_t NowMs_();
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    size_t _shardEntries;
+    int _ttlMs;
+    int _negativeTtlMs;
+    bool _isOpen;
+
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _negativeHits;
+    std::atomic<uint64_t> _misses;
+};
+
+#endif // USERCACHE_HPP
@@ -5,7 +5,12 @@ int main() {
     WebServer server(
         1316, 3, 60000, false,                      /* 端口 ET模式 timeoutMs 优雅退出  */
         3306, "root", "53656648lyxx", "webtest",    /* Mysql配置 */
-        12, 6, true, 1, 1024);                      /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, 6, true, 1, 1024,                       /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        0,                                          /* Reactor数量: 0为单Reactor+线程池, N为N个独立事件循环, -1为每核一个 */
+        64,                                         /* 静态文件缓存容量(MB), 0为关闭 */
+        1024, 64, 0,                                /* listen队列长度 每次唤醒最多accept的连接数 TCP_DEFER_ACCEPT秒数(0为关闭) */
+        60, 2,                                      /* 登录用户缓存TTL(秒), 0为关闭  SQL连接池最少保持的连接数(连接池数量为上限) */
+        256, 0, 0);                                 /* 每次写事件最多写出的KB数(0为不限) SO_SNDBUF(KB) TCP_NOTSENT_LOWAT(KB), 0为系统默认 */
     server.Start();
 } 
 